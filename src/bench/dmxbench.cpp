@@ -0,0 +1,461 @@
+//
+// Copyright(C) 2025-2026 Vitaliy Novichkov
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+/*
+ * Throughput benchmark of the chip emulators.
+ *
+ * Every emulator gets created through the opl3class::fm_init() like the synth
+ * does it, then plays the fixed register write scripts for the given duration
+ * of the audio. The result is printed as CSV (or as JSON lines) to the stdout:
+ *   emu,script,rate,frames,writes,elided,seconds,fps,realtime,ns_per_write
+ * where the "elided" is count of writes skipped by the shadow register cache,
+ * the "fps" is count of output frames made per second of the wall-clock time,
+ * the "realtime" is the same relative to the output sample rate, and the
+ * "ns_per_write" is the average time spent per one register write.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../utf8main/utf8main.h" // IWYU pragma: keep
+#include "../interface.h"
+#include "../emu_list.h"
+
+typedef std::chrono::steady_clock BenchClock;
+
+struct EmuName
+{
+    const char *name;
+    int emu;
+};
+
+static const EmuName s_emus[] =
+{
+    {"nuked",       EMU_NUKED_OPL3},
+    {"nuked-fast",  EMU_NUKED_OPL3_FAST},
+    {"nuked-cqm",   EMU_NUKED_CQM},
+    {"nuked-opl2",  EMU_NUKED_OPL2},
+    {"dosbox",      EMU_DOSBOX_OPL3},
+    {"java",        EMU_JAVA_OPL3},
+    {"opal",        EMU_OPAL_OPL3},
+    {"ymfm-opl2",   EMU_YMFM_OPL2},
+    {"ymfm-opl3",   EMU_YMFM_OPL3},
+    {"mame-opl2",   EMU_MAME_OPL2},
+    {"lle-opl2",    EMU_OPL2_LLE},
+    {"lle-opl3",    EMU_OPL3_LLE}
+};
+
+static const size_t s_emusCount = sizeof(s_emus) / sizeof(EmuName);
+
+/**
+ * @brief Register writer which measures the time spent on writes
+ */
+class BenchWriter
+{
+    fm_chip *m_chip;
+    BenchClock::duration m_time;
+    BenchClock::time_point m_begin;
+
+public:
+    explicit BenchWriter(fm_chip *chip) :
+        m_chip(chip),
+        m_time(BenchClock::duration::zero())
+    {}
+
+    void begin()
+    {
+        m_begin = BenchClock::now();
+    }
+
+    void end()
+    {
+        m_time += BenchClock::now() - m_begin;
+    }
+
+    void write(unsigned short reg, unsigned char data)
+    {
+        m_chip->fm_writereg(reg, data);
+    }
+
+    BenchClock::duration time() const
+    {
+        return m_time;
+    }
+};
+
+// Register offsets of the first operator of every 2-op channel of one bank
+static const unsigned short s_chanOp[9] = {0x00, 0x01, 0x02, 0x08, 0x09, 0x0A, 0x10, 0x11, 0x12};
+
+static inline unsigned short chanBank(unsigned ch)
+{
+    return ch >= 9 ? 0x100 : 0x000;
+}
+
+static void writeOperator(BenchWriter &w, unsigned short op, unsigned char ave, unsigned char ksl_tl,
+                          unsigned char ad, unsigned char sr, unsigned char wave)
+{
+    w.write(0x20 + op, ave);
+    w.write(0x40 + op, ksl_tl);
+    w.write(0x60 + op, ad);
+    w.write(0x80 + op, sr);
+    w.write(0xE0 + op, wave);
+}
+
+// An organ-like sustained patch on the given channel
+static void setupChannel(BenchWriter &w, unsigned ch)
+{
+    unsigned short bank = chanBank(ch);
+    unsigned short op = bank + s_chanOp[ch % 9];
+
+    writeOperator(w, op, 0x21, 0x18, 0xF2, 0x24, 0x00);
+    writeOperator(w, op + 3, 0x21, 0x00, 0xF2, 0x24, 0x01);
+    w.write(bank + 0xC0 + (ch % 9), 0x3A);
+}
+
+// Key-on of the note, where the note 0 is the C-1
+static void noteOn(BenchWriter &w, unsigned ch, unsigned note)
+{
+    static const unsigned short fnum[12] =
+    {
+        0x158, 0x16B, 0x181, 0x198, 0x1B0, 0x1CA, 0x1E5, 0x202, 0x220, 0x241, 0x263, 0x287
+    };
+    unsigned short bank = chanBank(ch);
+    unsigned block = (note / 12) > 7 ? 7 : (note / 12);
+    unsigned short f = fnum[note % 12];
+
+    w.write(bank + 0xA0 + (ch % 9), f & 0xFF);
+    w.write(bank + 0xB0 + (ch % 9), 0x20 | (block << 2) | (f >> 8));
+}
+
+static void noteOff(BenchWriter &w, unsigned ch)
+{
+    w.write(chanBank(ch) + 0xB0 + (ch % 9), 0x00);
+}
+
+struct BenchScript
+{
+    const char *name;
+    //! Count of frames between two ticks
+    unsigned tickFrames;
+    void (*setup)(BenchWriter &w);
+    void (*tick)(BenchWriter &w, unsigned long tick);
+};
+
+static void idleSetup(BenchWriter &)
+{}
+
+static void sustain9Setup(BenchWriter &w)
+{
+    for(unsigned ch = 0; ch < 9; ++ch)
+    {
+        setupChannel(w, ch);
+        noteOn(w, ch, 48 + ch * 4);
+    }
+}
+
+static void sustain18Setup(BenchWriter &w)
+{
+    w.write(0x105, 0x01);
+    w.write(0x104, 0x00);
+
+    for(unsigned ch = 0; ch < 18; ++ch)
+    {
+        setupChannel(w, ch);
+        noteOn(w, ch, 36 + ch * 3);
+    }
+}
+
+static void arpeggioSetup(BenchWriter &w)
+{
+    for(unsigned ch = 0; ch < 9; ++ch)
+        setupChannel(w, ch);
+}
+
+// Every tick retriggers all channels with the next step of the chord
+static void arpeggioTick(BenchWriter &w, unsigned long tick)
+{
+    static const unsigned steps[4] = {0, 4, 7, 12};
+
+    for(unsigned ch = 0; ch < 9; ++ch)
+    {
+        noteOff(w, ch);
+        noteOn(w, ch, 36 + ch * 5 + steps[(tick + ch) % 4]);
+    }
+}
+
+static void rhythmSetup(BenchWriter &w)
+{
+    // Bass drum
+    writeOperator(w, 0x10, 0x00, 0x0B, 0xA8, 0x4C, 0x00);
+    writeOperator(w, 0x13, 0x00, 0x00, 0xD6, 0x4F, 0x00);
+    w.write(0xC6, 0x38);
+    // Hi-hat and snare drum
+    writeOperator(w, 0x11, 0x01, 0x00, 0xF7, 0xB7, 0x00);
+    writeOperator(w, 0x14, 0x01, 0x00, 0xF7, 0xB7, 0x00);
+    w.write(0xC7, 0x38);
+    // Tom-tom and cymbal
+    writeOperator(w, 0x12, 0x05, 0x00, 0xF8, 0xB5, 0x00);
+    writeOperator(w, 0x15, 0x01, 0x00, 0xF5, 0xB5, 0x00);
+    w.write(0xC8, 0x38);
+
+    w.write(0xA6, 0x57);
+    w.write(0xB6, 0x09);
+    w.write(0xA7, 0x57);
+    w.write(0xB7, 0x0A);
+    w.write(0xA8, 0x57);
+    w.write(0xB8, 0x0A);
+
+    // The rest of channels keep playing melodic notes together with drums
+    for(unsigned ch = 0; ch < 6; ++ch)
+    {
+        setupChannel(w, ch);
+        noteOn(w, ch, 48 + ch * 3);
+    }
+
+    w.write(0xBD, 0x20);
+}
+
+static void rhythmTick(BenchWriter &w, unsigned long tick)
+{
+    static const unsigned char pattern[8] = {0x11, 0x01, 0x09, 0x01, 0x13, 0x01, 0x0D, 0x05};
+
+    w.write(0xBD, 0x20);
+    w.write(0xBD, 0x20 | pattern[tick % 8]);
+}
+
+static const BenchScript s_scripts[] =
+{
+    {"idle",        0,      idleSetup,      nullptr},
+    {"sustain9",    0,      sustain9Setup,  nullptr},
+    {"sustain18",   0,      sustain18Setup, nullptr},
+    {"arpeggio",    256,    arpeggioSetup,  arpeggioTick},
+    {"rhythm",      2048,   rhythmSetup,    rhythmTick}
+};
+
+static const size_t s_scriptsCount = sizeof(s_scripts) / sizeof(BenchScript);
+
+struct BenchResult
+{
+    unsigned long frames;
+    unsigned long writes;
+    unsigned long elided;
+    double seconds;
+    double writeSeconds;
+};
+
+static BenchResult runScript(int emu, const BenchScript &script, unsigned rate, double duration)
+{
+    enum { block = 512 };
+    std::vector<int> buffer(block * 2);
+    unsigned long total = static_cast<unsigned long>(duration * rate);
+    unsigned long done = 0, nextTick = 0, tick = 0;
+    fm_chip *chip = fm_chip::create();
+    BenchWriter w(chip);
+    BenchResult res;
+
+    chip->fm_init(emu, rate);
+
+    BenchClock::time_point begin = BenchClock::now();
+
+    w.begin();
+    script.setup(w);
+    w.end();
+
+    while(done < total)
+    {
+        unsigned long frames = total - done;
+
+        if(frames > block)
+            frames = block;
+
+        if(script.tick)
+        {
+            if(done == nextTick)
+            {
+                w.begin();
+                script.tick(w, tick++);
+                w.end();
+                nextTick += script.tickFrames;
+            }
+
+            if(frames > nextTick - done)
+                frames = nextTick - done;
+        }
+
+        chip->fm_generate(buffer.data(), static_cast<unsigned int>(frames));
+        done += frames;
+    }
+
+    BenchClock::time_point end = BenchClock::now();
+
+    res.frames = done;
+    chip->fm_write_stats(&res.writes, &res.elided);
+    res.seconds = std::chrono::duration<double>(end - begin).count();
+    res.writeSeconds = std::chrono::duration<double>(w.time()).count();
+
+    delete chip;
+
+    return res;
+}
+
+static bool matchFilter(const std::vector<const char *> &filter, const char *name)
+{
+    if(filter.empty())
+        return true;
+
+    for(size_t i = 0; i < filter.size(); ++i)
+    {
+        if(!std::strcmp(filter[i], name))
+            return true;
+    }
+
+    return false;
+}
+
+static bool validName(const char *name, bool isEmu)
+{
+    if(isEmu)
+    {
+        for(size_t i = 0; i < s_emusCount; ++i)
+            if(!std::strcmp(s_emus[i].name, name))
+                return true;
+    }
+    else
+    {
+        for(size_t i = 0; i < s_scriptsCount; ++i)
+            if(!std::strcmp(s_scripts[i].name, name))
+                return true;
+    }
+
+    return false;
+}
+
+static void printHelp()
+{
+    std::fprintf(stdout,
+                 "USAGE:\n\n"
+                 "  dmxbench [options]\n"
+                 "\n"
+                 "Supported options:\n"
+                 "  -emu <name>      - Benchmark only this emulator, can be repeated.\n"
+                 "                     By default every emulator is benchmarked:\n"
+                 "                     nuked, nuked-fast, nuked-cqm, nuked-opl2, dosbox, java, opal,\n"
+                 "                     ymfm-opl2, ymfm-opl3, mame-opl2, lle-opl2, lle-opl3\n"
+                 "  -script <name>   - Run only this script, can be repeated. By default all:\n"
+                 "                     idle, sustain9, sustain18, arpeggio, rhythm\n"
+                 "  -freq <rate>     - Output sample rate (default 48000).\n"
+                 "  -seconds <value> - Duration of the audio rendered per script (default 10).\n"
+                 "  -json            - Print results as JSON lines instead of CSV.\n"
+                 "\n");
+    std::fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<const char *> emuFilter, scriptFilter;
+    unsigned rate = 48000;
+    double duration = 10.0;
+    bool json = false;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const char *cur = argv[i];
+        bool hasArg = i + 1 < argc;
+
+        if(!std::strcmp(cur, "-json"))
+            json = true;
+        else if(!hasArg && (!std::strcmp(cur, "-emu") || !std::strcmp(cur, "-script") ||
+                            !std::strcmp(cur, "-freq") || !std::strcmp(cur, "-seconds")))
+        {
+            std::fprintf(stderr, "ERROR: Argument %s requires an option!\n", cur);
+            return 1;
+        }
+        else if(!std::strcmp(cur, "-emu") || !std::strcmp(cur, "-script"))
+        {
+            bool isEmu = cur[1] == 'e';
+
+            if(!validName(argv[++i], isEmu))
+            {
+                std::fprintf(stderr, "ERROR: Invalid %s name: %s\n", isEmu ? "emulator" : "script", argv[i]);
+                return 1;
+            }
+
+            (isEmu ? emuFilter : scriptFilter).push_back(argv[i]);
+        }
+        else if(!std::strcmp(cur, "-freq"))
+        {
+            rate = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+            if(rate == 0)
+            {
+                std::fprintf(stderr, "The option -freq requires a non-zero integer argument!\n");
+                return 1;
+            }
+        }
+        else if(!std::strcmp(cur, "-seconds"))
+        {
+            duration = std::strtod(argv[++i], nullptr);
+            if(duration <= 0.0)
+            {
+                std::fprintf(stderr, "The option -seconds requires a positive argument!\n");
+                return 1;
+            }
+        }
+        else
+        {
+            printHelp();
+            return !std::strcmp(cur, "-h") || !std::strcmp(cur, "--help") ? 0 : 1;
+        }
+    }
+
+    if(!json)
+        std::fprintf(stdout, "emu,script,rate,frames,writes,elided,seconds,fps,realtime,ns_per_write\n");
+
+    for(size_t e = 0; e < s_emusCount; ++e)
+    {
+        if(!matchFilter(emuFilter, s_emus[e].name))
+            continue;
+
+        for(size_t s = 0; s < s_scriptsCount; ++s)
+        {
+            if(!matchFilter(scriptFilter, s_scripts[s].name))
+                continue;
+
+            BenchResult r = runScript(s_emus[e].emu, s_scripts[s], rate, duration);
+            double fps = r.seconds > 0.0 ? r.frames / r.seconds : 0.0;
+            double nsPerWrite = r.writes > 0 ? r.writeSeconds * 1e9 / r.writes : 0.0;
+
+            if(json)
+            {
+                std::fprintf(stdout,
+                             "{\"emu\":\"%s\",\"script\":\"%s\",\"rate\":%u,\"frames\":%lu,\"writes\":%lu,"
+                             "\"elided\":%lu,\"seconds\":%.6f,\"fps\":%.1f,\"realtime\":%.3f,\"ns_per_write\":%.1f}\n",
+                             s_emus[e].name, s_scripts[s].name, rate, r.frames, r.writes,
+                             r.elided, r.seconds, fps, fps / rate, nsPerWrite);
+            }
+            else
+            {
+                std::fprintf(stdout, "%s,%s,%u,%lu,%lu,%lu,%.6f,%.1f,%.3f,%.1f\n",
+                             s_emus[e].name, s_scripts[s].name, rate, r.frames, r.writes,
+                             r.elided, r.seconds, fps, fps / rate, nsPerWrite);
+            }
+
+            std::fflush(stdout);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,278 @@
+/*
+ * Interfaces over Yamaha OPL3 (YMF262) chip emulators
+ *
+ * Copyright (c) 2017-2026 Vitaly Novichkov (Wohlstand)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef LINEAR_RESAMPLER_HPP_THING
+#define LINEAR_RESAMPLER_HPP_THING
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+  Linear interpolation of the stereo frames with the SIMD kernels.
+
+  Every output frame is made as:
+    out = (old * (ratio - cnt) + new * cnt) / divisor
+  where the division truncates toward zero like the C one does. The kernels
+  multiply by a precomputed fixed-point reciprocal of the divisor which is
+  chosen so that the result is bit-identical to the real division for every
+  possible dividend.
+ */
+
+#include "resampler_simd.hpp"
+
+struct LinearRsmDivider
+{
+    //! Divisor itself, used by the scalar code
+    int32_t divisor;
+    //! Fixed-point reciprocal of the divisor, zero when it can't be used
+    uint32_t mul;
+    //! Right shift applied after the multiplication by the reciprocal
+    uint32_t shift;
+};
+
+/**
+ * @brief Prepare the reciprocal of the divisor
+ * @param div Divider to setup
+ * @param divisor Positive divisor
+ * @param maxDividend Maximum absolute value of the dividend
+ */
+static inline void linearRsmSetupDivider(LinearRsmDivider *div, int32_t divisor, uint64_t maxDividend)
+{
+    uint64_t d = (uint64_t)divisor;
+    uint64_t limit = maxDividend * d;
+    uint32_t shift = 0;
+
+    div->divisor = divisor;
+    div->mul = 0;
+    div->shift = 0;
+
+    // The (|x| * mul) >> shift is equal to |x| / d for every |x| <= maxDividend
+    // while mul = 2^shift / d + 1 and 2^shift > maxDividend * d.
+    while(shift < 63 && ((uint64_t)1 << shift) <= limit)
+        ++shift;
+
+    if(divisor <= 0 || maxDividend >= 0x80000000ULL || shift >= 63)
+        return;
+
+    uint64_t mul = ((uint64_t)1 << shift) / d + 1;
+    if(mul > 0xFFFFFFFFULL)
+        return;
+
+    div->mul = (uint32_t)mul;
+    div->shift = shift;
+}
+
+/**
+ * @brief Interpolate the stereo frames
+ * @param in The frame before and the frame after of the first output frame
+ * @param output Output stereo frames
+ * @param frames Count of output frames
+ * @param samplecnt [in,out] Position between the input frames, in units of 1/ratio
+ * @param ratio Count of units per one input frame
+ * @param step Count of units per one output frame
+ * @param div The divider
+ * @return Pointer to the frame before the next output frame
+ */
+static inline const int32_t *linearRsmProcess(const int32_t *in, int32_t *output, size_t frames,
+                                              int32_t *samplecnt, int32_t ratio, int32_t step,
+                                              const LinearRsmDivider &div)
+{
+    int32_t cnt = *samplecnt;
+    size_t i = 0;
+
+#if defined(OPL_RESAMPLER_AVX2)
+    if(div.mul != 0)
+    {
+        const __m256i vratio = _mm256_set1_epi32(ratio);
+        const __m256i vmul = _mm256_set1_epi32((int32_t)div.mul);
+        const __m128i vshift = _mm_cvtsi32_si128((int)div.shift);
+
+        for(; i + 4 <= frames; i += 4)
+        {
+            const int32_t *p[4];
+            int32_t c[4];
+
+            for(unsigned j = 0; j < 4; ++j)
+            {
+                while(cnt >= ratio)
+                {
+                    in += 2;
+                    cnt -= ratio;
+                }
+                p[j] = in;
+                c[j] = cnt;
+                cnt += step;
+            }
+
+            // Each load gives (old L, old R, new L, new R) of one frame
+            __m256i v02 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p[0])),
+                                                  _mm_loadu_si128((const __m128i *)p[2]), 1);
+            __m256i v13 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p[1])),
+                                                  _mm_loadu_si128((const __m128i *)p[3]), 1);
+            __m256i a = _mm256_unpacklo_epi64(v02, v13);
+            __m256i b = _mm256_unpackhi_epi64(v02, v13);
+            __m256i wb = _mm256_set_epi32(c[3], c[3], c[2], c[2], c[1], c[1], c[0], c[0]);
+            __m256i wa = _mm256_sub_epi32(vratio, wb);
+
+            __m256i x = _mm256_add_epi32(_mm256_mullo_epi32(a, wa), _mm256_mullo_epi32(b, wb));
+            __m256i sign = _mm256_srai_epi32(x, 31);
+            __m256i ax = _mm256_sub_epi32(_mm256_xor_si256(x, sign), sign);
+
+            __m256i qe = _mm256_srl_epi64(_mm256_mul_epu32(ax, vmul), vshift);
+            __m256i qo = _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(ax, 32), vmul), vshift);
+            __m256i q = _mm256_or_si256(qe, _mm256_slli_epi64(qo, 32));
+
+            q = _mm256_sub_epi32(_mm256_xor_si256(q, sign), sign);
+            _mm256_storeu_si256((__m256i *)output, q);
+            output += 8;
+        }
+    }
+#elif defined(OPL_RESAMPLER_SSE2)
+    if(div.mul != 0)
+    {
+        const __m128i vratio = _mm_set1_epi32(ratio);
+        const __m128i vmul = _mm_set1_epi32((int32_t)div.mul);
+        const __m128i vshift = _mm_cvtsi32_si128((int)div.shift);
+
+        for(; i + 2 <= frames; i += 2)
+        {
+            const int32_t *p0, *p1;
+            int32_t c0, c1;
+
+            while(cnt >= ratio)
+            {
+                in += 2;
+                cnt -= ratio;
+            }
+            p0 = in;
+            c0 = cnt;
+            cnt += step;
+
+            while(cnt >= ratio)
+            {
+                in += 2;
+                cnt -= ratio;
+            }
+            p1 = in;
+            c1 = cnt;
+            cnt += step;
+
+            // Each load gives (old L, old R, new L, new R) of one frame
+            __m128i v0 = _mm_loadu_si128((const __m128i *)p0);
+            __m128i v1 = _mm_loadu_si128((const __m128i *)p1);
+            __m128i a = _mm_unpacklo_epi64(v0, v1);
+            __m128i b = _mm_unpackhi_epi64(v0, v1);
+            __m128i wb = _mm_set_epi32(c1, c1, c0, c0);
+            __m128i wa = _mm_sub_epi32(vratio, wb);
+
+            // SSE2 has no 32-bit multiplication of the low half,
+            // the even and the odd lanes are multiplied separately.
+            __m128i pae = _mm_mul_epu32(a, wa);
+            __m128i pao = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(wa, 32));
+            __m128i pbe = _mm_mul_epu32(b, wb);
+            __m128i pbo = _mm_mul_epu32(_mm_srli_epi64(b, 32), _mm_srli_epi64(wb, 32));
+            __m128i xe = _mm_add_epi32(pae, pbe);
+            __m128i xo = _mm_add_epi32(pao, pbo);
+            __m128i x = _mm_unpacklo_epi32(_mm_shuffle_epi32(xe, _MM_SHUFFLE(0, 0, 2, 0)),
+                                           _mm_shuffle_epi32(xo, _MM_SHUFFLE(0, 0, 2, 0)));
+
+            __m128i sign = _mm_srai_epi32(x, 31);
+            __m128i ax = _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+
+            __m128i qe = _mm_srl_epi64(_mm_mul_epu32(ax, vmul), vshift);
+            __m128i qo = _mm_srl_epi64(_mm_mul_epu32(_mm_srli_epi64(ax, 32), vmul), vshift);
+            __m128i q = _mm_or_si128(qe, _mm_slli_epi64(qo, 32));
+
+            q = _mm_sub_epi32(_mm_xor_si128(q, sign), sign);
+            _mm_storeu_si128((__m128i *)output, q);
+            output += 4;
+        }
+    }
+#elif defined(OPL_RESAMPLER_NEON)
+    if(div.mul != 0)
+    {
+        const int32x4_t vratio = vdupq_n_s32(ratio);
+        const uint32x2_t vmul = vdup_n_u32(div.mul);
+        const int64x2_t vshift = vdupq_n_s64(-(int64_t)div.shift);
+
+        for(; i + 2 <= frames; i += 2)
+        {
+            const int32_t *p0, *p1;
+            int32_t c0, c1;
+
+            while(cnt >= ratio)
+            {
+                in += 2;
+                cnt -= ratio;
+            }
+            p0 = in;
+            c0 = cnt;
+            cnt += step;
+
+            while(cnt >= ratio)
+            {
+                in += 2;
+                cnt -= ratio;
+            }
+            p1 = in;
+            c1 = cnt;
+            cnt += step;
+
+            // Each load gives (old L, old R, new L, new R) of one frame
+            int32x4_t v0 = vld1q_s32(p0);
+            int32x4_t v1 = vld1q_s32(p1);
+            int32x4_t a = vcombine_s32(vget_low_s32(v0), vget_low_s32(v1));
+            int32x4_t b = vcombine_s32(vget_high_s32(v0), vget_high_s32(v1));
+            int32x4_t wb = vcombine_s32(vdup_n_s32(c0), vdup_n_s32(c1));
+            int32x4_t wa = vsubq_s32(vratio, wb);
+
+            int32x4_t x = vmlaq_s32(vmulq_s32(a, wa), b, wb);
+            int32x4_t sign = vshrq_n_s32(x, 31);
+            uint32x4_t ax = vreinterpretq_u32_s32(vsubq_s32(veorq_s32(x, sign), sign));
+
+            uint64x2_t ql = vshlq_u64(vmull_u32(vget_low_u32(ax), vmul), vshift);
+            uint64x2_t qh = vshlq_u64(vmull_u32(vget_high_u32(ax), vmul), vshift);
+            int32x4_t q = vreinterpretq_s32_u32(vcombine_u32(vmovn_u64(ql), vmovn_u64(qh)));
+
+            q = vsubq_s32(veorq_s32(q, sign), sign);
+            vst1q_s32(output, q);
+            output += 4;
+        }
+    }
+#endif
+
+    for(; i < frames; ++i)
+    {
+        while(cnt >= ratio)
+        {
+            in += 2;
+            cnt -= ratio;
+        }
+        output[0] = (in[0] * (ratio - cnt) + in[2] * cnt) / div.divisor;
+        output[1] = (in[1] * (ratio - cnt) + in[3] * cnt) / div.divisor;
+        cnt += step;
+        output += 2;
+    }
+
+    *samplecnt = cnt;
+    return in;
+}
+
+#endif // LINEAR_RESAMPLER_HPP_THING
@@ -0,0 +1,320 @@
+/*
+ * Interfaces over Yamaha OPL3 (YMF262) chip emulators
+ *
+ * Copyright (c) 2017-2026 Vitaly Novichkov (Wohlstand)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef POLYPHASE_RESAMPLER_HPP_THING
+#define POLYPHASE_RESAMPLER_HPP_THING
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <cmath>
+#include <vector>
+
+/*
+  Band-limited resampling of the stereo frames by the polyphase FIR filter.
+
+  The filter is a Kaiser-windowed sinc, its bank keeps the coefficients for
+  the fixed count of fractional positions between two input frames. Every
+  output frame is the blend of the dot products with two neighbour phases,
+  so the position is not quantized to the phase step. The position itself
+  is tracked as an exact fraction of the input and the output rates, it
+  never drifts.
+
+  The history of input frames is kept as planar float arrays, the dot
+  products are made with the SIMD kernels where they are available.
+ */
+
+#include "resampler_simd.hpp"
+
+class PolyphaseResampler
+{
+public:
+    PolyphaseResampler()
+        : m_inRate(1), m_outRate(1), m_cnt(0), m_taps(0), m_histPos(0)
+    {}
+
+    /**
+     * @brief Compute the filter bank for the given conversion
+     * @param inRate Rate of input frames
+     * @param outRate Rate of output frames
+     */
+    void setup(uint32_t inRate, uint32_t outRate)
+    {
+        // Shape of the Kaiser window, about 80 dB of stop band attenuation
+        const double kaiserBeta = 8.0;
+        // Transition width multiplied by the filter length
+        const double transitionWidth = 2.5;
+        const double pi = 3.14159265358979323846;
+
+        m_inRate = inRate;
+        m_outRate = outRate;
+
+        // Twice longer filter is needed per every halving of the bandwidth
+        unsigned halfLen = baseHalfLength;
+        if(outRate < inRate)
+            halfLen = (unsigned)std::ceil((double)baseHalfLength * inRate / outRate);
+        halfLen = (halfLen + 3) & ~3u;
+        if(halfLen > maxHalfLength)
+            halfLen = maxHalfLength;
+        m_taps = 2 * halfLen;
+
+        // The stop band begins at the output's Nyquist frequency
+        double bandwidth = (outRate < inRate) ? ((double)outRate / inRate) : 1.0;
+        double cutoff = 0.5 * bandwidth - transitionWidth / m_taps;
+        double i0beta = besselI0(kaiserBeta);
+
+        m_bank.resize((phases + 1) * m_taps);
+        for(unsigned k = 0; k <= phases; ++k)
+        {
+            float *row = &m_bank[k * m_taps];
+            double sum = 0.0;
+            for(unsigned j = 0; j < m_taps; ++j)
+            {
+                double x = (double)j - halfLen + 1 - (double)k / phases;
+                double w = x / halfLen;
+                w = (w < 1.0 && w > -1.0) ? besselI0(kaiserBeta * std::sqrt(1.0 - w * w)) / i0beta : 0.0;
+                double arg = 2.0 * cutoff * x;
+                double sinc = (arg == 0.0) ? 1.0 : std::sin(pi * arg) / (pi * arg);
+                double h = 2.0 * cutoff * sinc * w;
+                row[j] = (float)h;
+                sum += h;
+            }
+            // Unity gain at DC on every phase
+            for(unsigned j = 0; j < m_taps; ++j)
+                row[j] = (float)(row[j] / sum);
+        }
+
+        m_hist[0].resize(m_taps + histBlock);
+        m_hist[1].resize(m_taps + histBlock);
+        reset();
+    }
+
+    /**
+     * @brief Clear the history and the position
+     */
+    void reset()
+    {
+        m_cnt = 0;
+        m_histPos = m_taps;
+        for(unsigned c = 0; c < 2; ++c)
+        {
+            if(!m_hist[c].empty())
+                memset(&m_hist[c][0], 0, m_hist[c].size() * sizeof(float));
+        }
+    }
+
+    /**
+     * @brief Count of input frames consumed while making the output frames
+     * @param outFrames Count of output frames
+     * @return Count of input frames
+     */
+    size_t inputFramesFor(size_t outFrames) const
+    {
+        if(outFrames == 0)
+            return 0;
+        return (size_t)(((uint64_t)m_cnt + (uint64_t)(outFrames - 1) * m_inRate) / m_outRate);
+    }
+
+    /**
+     * @brief Maximum count of output frames made from the input frames
+     * @param inFrames Count of input frames
+     * @return Count of output frames
+     */
+    size_t outputFramesFor(size_t inFrames) const
+    {
+        return (size_t)(((uint64_t)(inFrames + 1) * m_outRate - 1 - m_cnt) / m_inRate) + 1;
+    }
+
+    /**
+     * @brief Resample the stereo frames
+     * @param in Input frames, exactly inputFramesFor(frames) of them
+     * @param output Output frames
+     * @param frames Count of output frames
+     * @param scale Amplitude factor applied on input
+     */
+    void process(const int16_t *in, int32_t *output, size_t frames, float scale)
+    {
+        const unsigned taps = m_taps;
+        const uint32_t inRate = m_inRate;
+        const uint32_t outRate = m_outRate;
+        const double phaseScale = (double)phases / outRate;
+        uint32_t cnt = m_cnt;
+        size_t pos = m_histPos;
+        float *histL = &m_hist[0][0];
+        float *histR = &m_hist[1][0];
+
+        for(size_t i = 0; i < frames; ++i)
+        {
+            while(cnt >= outRate)
+            {
+                if(pos == taps + histBlock)
+                {
+                    memmove(histL, histL + histBlock, taps * sizeof(float));
+                    memmove(histR, histR + histBlock, taps * sizeof(float));
+                    pos = taps;
+                }
+                histL[pos] = scale * (float)in[0];
+                histR[pos] = scale * (float)in[1];
+                ++pos;
+                in += 2;
+                cnt -= outRate;
+            }
+
+            double phase = cnt * phaseScale;
+            unsigned k = (unsigned)phase;
+            float frac = (float)(phase - k);
+            const float *c0 = &m_bank[k * taps];
+            float d[4];
+            dotProducts(histL + pos - taps, histR + pos - taps, c0, c0 + taps, taps, d);
+
+            output[0] = static_cast<int32_t>(lround(d[0] + frac * (d[1] - d[0])));
+            output[1] = static_cast<int32_t>(lround(d[2] + frac * (d[3] - d[2])));
+            output += 2;
+            cnt += inRate;
+        }
+
+        m_cnt = cnt;
+        m_histPos = pos;
+    }
+
+private:
+    enum
+    {
+        //! Count of fractional positions in the filter bank
+        phases = 256,
+        //! Half of the filter length when there is no downsampling
+        baseHalfLength = 32,
+        //! Limit of the half of the filter length
+        maxHalfLength = 128,
+        //! Count of input frames appended to the history before it gets shifted
+        histBlock = 1024
+    };
+
+    static double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        double q = x * x * 0.25;
+        for(unsigned n = 1; n < 64 && term > sum * 1e-12; ++n)
+        {
+            term *= q / ((double)n * n);
+            sum += term;
+        }
+        return sum;
+    }
+
+    /**
+     * @brief Dot products of two channels with two filter phases
+     * @param xl Left channel history
+     * @param xr Right channel history
+     * @param c0 Coefficients of the phase
+     * @param c1 Coefficients of the next phase
+     * @param taps Filter length, a multiple of 8
+     * @param d [out] Results: left by c0, left by c1, right by c0, right by c1
+     */
+    static void dotProducts(const float *xl, const float *xr,
+                            const float *c0, const float *c1,
+                            unsigned taps, float *d)
+    {
+#if defined(OPL_RESAMPLER_AVX2)
+        __m256 l0 = _mm256_setzero_ps(), l1 = _mm256_setzero_ps();
+        __m256 r0 = _mm256_setzero_ps(), r1 = _mm256_setzero_ps();
+        for(unsigned j = 0; j < taps; j += 8)
+        {
+            __m256 a = _mm256_loadu_ps(c0 + j);
+            __m256 b = _mm256_loadu_ps(c1 + j);
+            __m256 x = _mm256_loadu_ps(xl + j);
+            __m256 y = _mm256_loadu_ps(xr + j);
+            l0 = _mm256_add_ps(l0, _mm256_mul_ps(x, a));
+            l1 = _mm256_add_ps(l1, _mm256_mul_ps(x, b));
+            r0 = _mm256_add_ps(r0, _mm256_mul_ps(y, a));
+            r1 = _mm256_add_ps(r1, _mm256_mul_ps(y, b));
+        }
+        // Transpose-add the four accumulators into one vector of sums
+        __m256 s01 = _mm256_hadd_ps(l0, l1);
+        __m256 s23 = _mm256_hadd_ps(r0, r1);
+        __m256 s = _mm256_hadd_ps(s01, s23);
+        __m128 v = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+        _mm_storeu_ps(d, v);
+#elif defined(OPL_RESAMPLER_SSE2)
+        __m128 l0 = _mm_setzero_ps(), l1 = _mm_setzero_ps();
+        __m128 r0 = _mm_setzero_ps(), r1 = _mm_setzero_ps();
+        for(unsigned j = 0; j < taps; j += 4)
+        {
+            __m128 a = _mm_loadu_ps(c0 + j);
+            __m128 b = _mm_loadu_ps(c1 + j);
+            __m128 x = _mm_loadu_ps(xl + j);
+            __m128 y = _mm_loadu_ps(xr + j);
+            l0 = _mm_add_ps(l0, _mm_mul_ps(x, a));
+            l1 = _mm_add_ps(l1, _mm_mul_ps(x, b));
+            r0 = _mm_add_ps(r0, _mm_mul_ps(y, a));
+            r1 = _mm_add_ps(r1, _mm_mul_ps(y, b));
+        }
+        // Transpose the four accumulators, then sum up the rows
+        _MM_TRANSPOSE4_PS(l0, l1, r0, r1);
+        _mm_storeu_ps(d, _mm_add_ps(_mm_add_ps(l0, l1), _mm_add_ps(r0, r1)));
+#elif defined(OPL_RESAMPLER_NEON)
+        float32x4_t l0 = vdupq_n_f32(0.0f), l1 = vdupq_n_f32(0.0f);
+        float32x4_t r0 = vdupq_n_f32(0.0f), r1 = vdupq_n_f32(0.0f);
+        for(unsigned j = 0; j < taps; j += 4)
+        {
+            float32x4_t a = vld1q_f32(c0 + j);
+            float32x4_t b = vld1q_f32(c1 + j);
+            float32x4_t x = vld1q_f32(xl + j);
+            float32x4_t y = vld1q_f32(xr + j);
+            l0 = vmlaq_f32(l0, x, a);
+            l1 = vmlaq_f32(l1, x, b);
+            r0 = vmlaq_f32(r0, y, a);
+            r1 = vmlaq_f32(r1, y, b);
+        }
+        float32x2_t sl = vpadd_f32(vadd_f32(vget_low_f32(l0), vget_high_f32(l0)),
+                                   vadd_f32(vget_low_f32(l1), vget_high_f32(l1)));
+        float32x2_t sr = vpadd_f32(vadd_f32(vget_low_f32(r0), vget_high_f32(r0)),
+                                   vadd_f32(vget_low_f32(r1), vget_high_f32(r1)));
+        vst1q_f32(d, vcombine_f32(sl, sr));
+#else
+        float l0 = 0.0f, l1 = 0.0f, r0 = 0.0f, r1 = 0.0f;
+        for(unsigned j = 0; j < taps; ++j)
+        {
+            l0 += xl[j] * c0[j];
+            l1 += xl[j] * c1[j];
+            r0 += xr[j] * c0[j];
+            r1 += xr[j] * c1[j];
+        }
+        d[0] = l0;
+        d[1] = l1;
+        d[2] = r0;
+        d[3] = r1;
+#endif
+    }
+
+    uint32_t m_inRate;
+    uint32_t m_outRate;
+    //! Position between the input frames, in units of 1/outRate
+    uint32_t m_cnt;
+    unsigned m_taps;
+    //! Filter bank, phases + 1 rows of m_taps coefficients
+    std::vector<float> m_bank;
+    //! Planar history of input frames
+    std::vector<float> m_hist[2];
+    //! Write position in the history
+    size_t m_histPos;
+};
+
+#endif // POLYPHASE_RESAMPLER_HPP_THING
@@ -0,0 +1,44 @@
+/*
+ * Interfaces over Yamaha OPL3 (YMF262) chip emulators
+ *
+ * Copyright (c) 2017-2026 Vitaly Novichkov (Wohlstand)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef RESAMPLER_SIMD_HPP_THING
+#define RESAMPLER_SIMD_HPP_THING
+
+/*
+  Selection of the SIMD instruction set used by the resampler kernels,
+  done at compile time by the target flags of the compiler.
+
+  Define OPL_RESAMPLER_NO_SIMD to force the scalar code.
+ */
+
+#if !defined(OPL_RESAMPLER_NO_SIMD)
+#   if defined(__AVX2__)
+#       include <immintrin.h>
+#       define OPL_RESAMPLER_AVX2
+#   elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#       include <emmintrin.h>
+#       define OPL_RESAMPLER_SSE2
+#   elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#       include <arm_neon.h>
+#       define OPL_RESAMPLER_NEON
+#   endif
+#endif
+
+#endif // RESAMPLER_SIMD_HPP_THING
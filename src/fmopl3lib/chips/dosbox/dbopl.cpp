@@ -1505,12 +1505,11 @@ void Chip::Setup( Bit32u rate ) {
 	}
 }
 
-static volatile bool doneTables = false;
+static bool doneTables = false;
 static Mutex mutexTables;
 
 void InitTables( void ) {
-	if ( doneTables )
-		return;
+	// Only called on the chip creation, always take the lock
 	MutexHolder lock( mutexTables );
 	if ( doneTables )
 		return;
@@ -22,11 +22,13 @@
 #include "dosbox/dbopl.h"
 #include <new>
 #include <cstdlib>
+#include <cstring>
 #include <assert.h>
 
 DosBoxOPL3::DosBoxOPL3() :
     OPLChipBaseBufferedT(),
-    m_chip(new DBOPL::Handler)
+    m_chip(new DBOPL::Handler),
+    m_idle(false)
 {
     DosBoxOPL3::reset();
 }
@@ -45,6 +47,7 @@ void DosBoxOPL3::globalPreInit()
 void DosBoxOPL3::setRate(uint32_t rate)
 {
     OPLChipBaseBufferedT::setRate(rate);
+    m_idle = false;
     DBOPL::Handler *chip_r = reinterpret_cast<DBOPL::Handler*>(m_chip);
     chip_r->~Handler();
     new(chip_r) DBOPL::Handler;
@@ -54,6 +57,7 @@ void DosBoxOPL3::setRate(uint32_t rate)
 void DosBoxOPL3::reset()
 {
     OPLChipBaseBufferedT::reset();
+    m_idle = false;
     DBOPL::Handler *chip_r = reinterpret_cast<DBOPL::Handler*>(m_chip);
     chip_r->~Handler();
     new(chip_r) DBOPL::Handler;
@@ -62,6 +66,7 @@ void DosBoxOPL3::reset()
 
 void DosBoxOPL3::writeReg(uint16_t addr, uint8_t data)
 {
+    m_idle = false;
     DBOPL::Handler *chip_r = reinterpret_cast<DBOPL::Handler*>(m_chip);
     chip_r->WriteReg(static_cast<Bit32u>(addr), data);
 }
@@ -72,11 +77,41 @@ void DosBoxOPL3::writePan(uint16_t addr, uint8_t data)
     chip_r->WritePan(static_cast<Bit32u>(addr), data);
 }
 
+void DosBoxOPL3::checkIdle(const int16_t *lastFrame)
+{
+    const DBOPL::Handler *chip_r = reinterpret_cast<const DBOPL::Handler*>(m_chip);
+
+    if(lastFrame[0] != 0 || lastFrame[1] != 0)
+        return;
+
+    // Operators leave the OFF state only by the key-on
+    for(size_t ch = 0; ch < 18; ++ch)
+    {
+        if(chip_r->chip.chan[ch].op[0].state != DBOPL::Operator::OFF ||
+           chip_r->chip.chan[ch].op[1].state != DBOPL::Operator::OFF)
+            return;
+    }
+
+    m_idle = true;
+}
+
 void DosBoxOPL3::nativeGenerateN(int16_t *output, size_t frames)
 {
     DBOPL::Handler *chip_r = reinterpret_cast<DBOPL::Handler*>(m_chip);
+    int16_t *lastFrame;
     Bitu frames_i;
 
+    if(frames == 0)
+        return;
+
+    lastFrame = output + (frames - 1) * 2;
+
+    if(m_idle)
+    {
+        std::memset(output, 0, frames * 2 * sizeof(int16_t));
+        return;
+    }
+
     while(frames > 0)
     {
         frames_i = frames;
@@ -84,6 +119,8 @@ void DosBoxOPL3::nativeGenerateN(int16_t *output, size_t frames)
         frames -= frames_i;
         output += frames_i;
     }
+
+    checkIdle(lastFrame);
 }
 
 const char *DosBoxOPL3::emulatorName()
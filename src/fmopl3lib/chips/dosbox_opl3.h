@@ -26,6 +26,11 @@
 class DosBoxOPL3 final : public OPLChipBaseBufferedT<DosBoxOPL3>
 {
     void *m_chip;
+    //! All operators are silent, the output is zero until the next write
+    bool m_idle;
+
+    void checkIdle(const int16_t *lastFrame);
+
 public:
     DosBoxOPL3();
     ~DosBoxOPL3() override;
@@ -87,6 +87,7 @@ Revision History:
 #include <string>
 //#include "driver.h"		/* use M.A.M.E. */
 #include "opl.h"
+#include "../common/mutex.hpp"
 
 /* compiler dependence */
 #ifndef OSD_CPU_H
@@ -1098,6 +1099,8 @@ static void init_tables(void)
 
 	/* We only need to do this once. */
 	static bool did_init = false;
+	static Mutex did_init_mutex;
+	MutexHolder lock(did_init_mutex);
 
 	if (did_init)
 	{
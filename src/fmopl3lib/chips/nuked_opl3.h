@@ -26,6 +26,11 @@
 class NukedOPL3 final : public OPLChipBaseT<NukedOPL3>
 {
     void *m_chip;
+    //! All operators are silent, the output is zero until the next write
+    bool m_idle;
+
+    void checkIdle(const int16_t *lastFrame);
+
 public:
     NukedOPL3();
     ~NukedOPL3() override;
@@ -38,6 +43,7 @@ public:
     void nativePreGenerate() override {}
     void nativePostGenerate() override {}
     void nativeGenerate(int16_t *frame) override;
+    void nativeGenerateN(int16_t *output, size_t frames);
     const char *emulatorName() override;
     ChipType chipType() override;
     bool hasFullPanning() override;
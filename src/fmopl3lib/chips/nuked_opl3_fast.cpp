@@ -23,7 +23,8 @@
 #include <cstring>
 
 NukedOPL3Fast::NukedOPL3Fast() :
-    OPLChipBaseT()
+    OPLChipBaseT(),
+    m_idle(false)
 {
     m_chip = new opl3_chip;
     NukedOPL3Fast::setRate(m_rate);
@@ -38,6 +39,7 @@ NukedOPL3Fast::~NukedOPL3Fast()
 void NukedOPL3Fast::setRate(uint32_t rate)
 {
     OPLChipBaseT::setRate(rate);
+    m_idle = false;
     opl3_chip *chip_r = reinterpret_cast<opl3_chip*>(m_chip);
     std::memset(chip_r, 0, sizeof(opl3_chip));
     OPL3Fast_Reset(chip_r, rate);
@@ -46,6 +48,7 @@ void NukedOPL3Fast::setRate(uint32_t rate)
 void NukedOPL3Fast::reset()
 {
     OPLChipBaseT::reset();
+    m_idle = false;
     opl3_chip *chip_r = reinterpret_cast<opl3_chip*>(m_chip);
     std::memset(chip_r, 0, sizeof(opl3_chip));
     OPL3Fast_Reset(chip_r, m_rate);
@@ -53,6 +56,7 @@ void NukedOPL3Fast::reset()
 
 void NukedOPL3Fast::writeReg(uint16_t addr, uint8_t data)
 {
+    m_idle = false;
     opl3_chip *chip_r = reinterpret_cast<opl3_chip*>(m_chip);
     OPL3Fast_WriteRegBuffered(chip_r, addr, data);
 }
@@ -63,12 +67,57 @@ void NukedOPL3Fast::writePan(uint16_t addr, uint8_t data)
     OPL3Fast_WritePan(chip_r, addr, data);
 }
 
+void NukedOPL3Fast::checkIdle(const int16_t *lastFrame)
+{
+    const opl3_chip *chip_r = reinterpret_cast<const opl3_chip*>(m_chip);
+
+    if(lastFrame[0] != 0 || lastFrame[1] != 0)
+        return;
+
+    // Buffered writes are still waiting to be applied
+    if(chip_r->writebuf[chip_r->writebuf_cur].reg & 0x200)
+        return;
+
+    // Every envelope is released and fully decayed: it stays so until the next key-on
+    for(size_t i = 0; i < 36; ++i)
+    {
+        const opl3_slot &slot = chip_r->slot[i];
+        if(slot.key != 0 || slot.eg_rout != 0x1ff || slot.eg_gen != 3 /* release */)
+            return;
+    }
+
+    m_idle = true;
+}
+
 void NukedOPL3Fast::nativeGenerate(int16_t *frame)
 {
+    if(m_idle)
+    {
+        frame[0] = 0;
+        frame[1] = 0;
+        return;
+    }
+
     opl3_chip *chip_r = reinterpret_cast<opl3_chip*>(m_chip);
     OPL3Fast_Generate(chip_r, frame);
 }
 
+void NukedOPL3Fast::nativeGenerateN(int16_t *output, size_t frames)
+{
+    if(m_idle)
+    {
+        std::memset(output, 0, frames * 2 * sizeof(int16_t));
+        return;
+    }
+
+    opl3_chip *chip_r = reinterpret_cast<opl3_chip*>(m_chip);
+    for(size_t i = 0; i < frames; ++i)
+        OPL3Fast_Generate(chip_r, output + i * 2);
+
+    if(frames > 0)
+        checkIdle(output + (frames - 1) * 2);
+}
+
 const char *NukedOPL3Fast::emulatorName()
 {
     return "Nuked OPL3 Fast (by tgies)";
@@ -29,6 +29,11 @@
 class NukedOPL3Fast final : public OPLChipBaseT<NukedOPL3Fast>
 {
     void *m_chip;
+    //! All operators are silent, the output is zero until the next write
+    bool m_idle;
+
+    void checkIdle(const int16_t *lastFrame);
+
 public:
     NukedOPL3Fast();
     ~NukedOPL3Fast() override;
@@ -41,6 +46,7 @@ public:
     void nativePreGenerate() override {}
     void nativePostGenerate() override {}
     void nativeGenerate(int16_t *frame) override;
+    void nativeGenerateN(int16_t *output, size_t frames);
     const char *emulatorName() override;
     ChipType chipType() override;
     bool hasFullPanning() override;
@@ -28,7 +28,9 @@
 #endif
 
 #if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-class VResampler;
+#include "common/polyphase_resampler.hpp"
+#else
+#include "common/linear_resampler.hpp"
 #endif
 
 #if defined(ADLMIDI_AUDIO_TICK_HANDLER)
@@ -48,6 +50,20 @@ public:
 protected:
     uint32_t m_id;
     uint32_t m_rate;
+
+    // register write waiting for its moment
+    struct QueuedWrite
+    {
+        uint32_t time;
+        uint16_t addr;
+        uint8_t data;
+    };
+    enum { writeQueueSize = 512 };
+    QueuedWrite m_writeQueue[writeQueueSize];
+    unsigned m_writeQueueHead;
+    unsigned m_writeQueueCount;
+    // count of output frames generated, the time base of queued writes
+    uint32_t m_writeClock;
 public:
     OPLChipBase();
     virtual ~OPLChipBase();
@@ -55,6 +71,22 @@ public:
     uint32_t chipId() const { return m_id; }
     void setChipId(uint32_t id) { m_id = id; }
 
+    /**
+     * @brief Write the register at the given moment of the output
+     * @param offset Count of output frames, since the start of the next generated block,
+     *        to be generated before the write gets applied
+     * @param addr Register address
+     * @param data Register value
+     *
+     * The generators render the runs between the queued writes at once.
+     * The writes of the same moment get applied in the order of the calls.
+     */
+    void writeRegAt(uint32_t offset, uint16_t addr, uint8_t data);
+    /**
+     * @brief Apply all the queued writes immediately
+     */
+    void flushWriteQueue();
+
     virtual bool canRunAtPcmRate() const = 0;
     virtual bool isRunningAtPcmRate() const = 0;
     virtual bool setRunningAtPcmRate(bool r) = 0;
@@ -79,6 +111,8 @@ public:
     virtual void generateAndMix(int16_t *output, size_t frames) = 0;
     virtual void generate32(int32_t *output, size_t frames) = 0;
     virtual void generateAndMix32(int32_t *output, size_t frames) = 0;
+    // normalized output, the full scale of 16-bit samples is the [-1, 1] range
+    virtual void generateFloat(float *output, size_t frames) = 0;
 
     virtual const char* emulatorName() = 0;
     virtual ChipType chipType() = 0;
@@ -114,23 +148,41 @@ public:
     void generateAndMix(int16_t *output, size_t frames) override;
     void generate32(int32_t *output, size_t frames) override;
     void generateAndMix32(int32_t *output, size_t frames) override;
+    void generateFloat(float *output, size_t frames) override;
+protected:
+    // Generic block generator which makes the frame-by-frame calls of the
+    // emulator; emulations having a block routine should "redefine" it,
+    // the static polymorphism will accept it.
+    void nativeGenerateN(int16_t *output, size_t frames);
 private:
     bool m_runningAtPcmRate;
 #if defined(ADLMIDI_AUDIO_TICK_HANDLER)
     void *m_audioTickHandlerInstance;
 #endif
     void nativeTick(int16_t *frame);
+    void nativeTickN(int16_t *output, size_t frames);
+    void applyDueWrites();
+    void queuedGenerateN(int32_t *output, size_t frames);
     void setupResampler(uint32_t rate);
     void resetResampler();
     void resampledGenerate(int32_t *output) override;
+    void resampledGenerateN(int32_t *output, size_t frames);
+    // size of the blocks of output frames used by the 16-bit, float and mixing generators
+    enum { outputBlock = 256 };
+    // maximum count of native frames rendered at once
+    enum { nativeBlock = 512 };
+    int16_t m_nativeBuffer[2 * nativeBlock];
 #if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-    VResampler *m_resampler;
+    PolyphaseResampler m_resampler;
 #else
     int32_t m_oldsamples[2];
     int32_t m_samples[2];
     int32_t m_samplecnt;
     int32_t m_rateratio;
+    LinearRsmDivider m_rsmDivider;
     enum { rsm_frac = 10 };
+    // the two last frames of previous block, followed by the new block
+    int32_t m_rsmBuffer[2 * (nativeBlock + 2)];
 #endif
     // amplitude scale factors in and out of resampler, varying for chips;
     // values are OK to "redefine", the static polymorphism will accept it.
@@ -140,6 +192,8 @@ private:
 // A base class which provides frame-by-frame interfaces on emulations which
 // don't have a routine for it. It produces outputs in fixed size buffers.
 // Fast register updates will suffer some latency because of buffering.
+// The block generators call the emulator's routine directly and don't
+// suffer of that latency.
 template <class T, unsigned Buffer = 256>
 class OPLChipBaseBufferedT : public OPLChipBaseT<T>
 {
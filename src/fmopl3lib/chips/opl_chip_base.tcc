@@ -1,10 +1,6 @@
 #include "opl_chip_base.h"
 #include <cmath>
 
-#if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-#include <zita-resampler/vresampler.h>
-#endif
-
 #if !defined(LIKELY) && defined(__GNUC__)
 #define LIKELY(x) __builtin_expect((x), 1)
 #elif !defined(LIKELY)
@@ -21,7 +17,10 @@
 
 inline OPLChipBase::OPLChipBase() :
     m_id(0),
-    m_rate(44100)
+    m_rate(44100),
+    m_writeQueueHead(0),
+    m_writeQueueCount(0),
+    m_writeClock(0)
 {
 }
 
@@ -29,6 +28,48 @@ inline OPLChipBase::~OPLChipBase()
 {
 }
 
+inline void OPLChipBase::writeRegAt(uint32_t offset, uint16_t addr, uint8_t data)
+{
+    uint32_t time = m_writeClock + offset;
+
+    if(m_writeQueueCount == (unsigned)writeQueueSize)
+    {
+        // No room: the oldest write gets applied earlier than it should
+        const QueuedWrite &w = m_writeQueue[m_writeQueueHead];
+        writeReg(w.addr, w.data);
+        m_writeQueueHead = (m_writeQueueHead + 1) % writeQueueSize;
+        --m_writeQueueCount;
+    }
+
+    // Keep the queue sorted by time, usually the new write goes to the end
+    unsigned pos = m_writeQueueCount;
+    while(pos > 0)
+    {
+        const QueuedWrite &prev = m_writeQueue[(m_writeQueueHead + pos - 1) % writeQueueSize];
+        if((int32_t)(prev.time - time) <= 0)
+            break;
+        m_writeQueue[(m_writeQueueHead + pos) % writeQueueSize] = prev;
+        --pos;
+    }
+
+    QueuedWrite &w = m_writeQueue[(m_writeQueueHead + pos) % writeQueueSize];
+    w.time = time;
+    w.addr = addr;
+    w.data = data;
+    ++m_writeQueueCount;
+}
+
+inline void OPLChipBase::flushWriteQueue()
+{
+    while(m_writeQueueCount > 0)
+    {
+        const QueuedWrite &w = m_writeQueue[m_writeQueueHead];
+        writeReg(w.addr, w.data);
+        m_writeQueueHead = (m_writeQueueHead + 1) % writeQueueSize;
+        --m_writeQueueCount;
+    }
+}
+
 /* OPLChipBaseT */
 
 template <class T>
@@ -40,18 +81,12 @@ OPLChipBaseT<T>::OPLChipBaseT()
       m_audioTickHandlerInstance(NULL)
 #endif
 {
-#if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-    m_resampler = new VResampler;
-#endif
     setupResampler(m_rate);
 }
 
 template <class T>
 OPLChipBaseT<T>::~OPLChipBaseT()
 {
-#if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-    delete m_resampler;
-#endif
 }
 
 template <class T>
@@ -102,23 +137,29 @@ template <class T>
 void OPLChipBaseT<T>::reset()
 {
     resetResampler();
+    m_writeQueueHead = 0;
+    m_writeQueueCount = 0;
+    m_writeClock = 0;
 }
 
 template <class T>
 void OPLChipBaseT<T>::generate(int16_t *output, size_t frames)
 {
+    int32_t block[2 * outputBlock];
     static_cast<T *>(this)->nativePreGenerate();
-    for(size_t i = 0; i < frames; ++i)
+    while(frames > 0)
     {
-        int32_t frame[2];
-        static_cast<T *>(this)->resampledGenerate(frame);
-        for (unsigned c = 0; c < 2; ++c) {
-            int32_t temp = frame[c];
+        size_t count = (frames < (size_t)outputBlock) ? frames : (size_t)outputBlock;
+        queuedGenerateN(block, count);
+        for(size_t i = 0; i < 2 * count; ++i)
+        {
+            int32_t temp = block[i];
             temp = (temp > -32768) ? temp : -32768;
             temp = (temp < 32767) ? temp : 32767;
-            output[c] = (int16_t)temp;
+            output[i] = (int16_t)temp;
         }
-        output += 2;
+        output += 2 * count;
+        frames -= count;
     }
     static_cast<T *>(this)->nativePostGenerate();
 }
@@ -126,18 +167,21 @@ void OPLChipBaseT<T>::generate(int16_t *output, size_t frames)
 template <class T>
 void OPLChipBaseT<T>::generateAndMix(int16_t *output, size_t frames)
 {
+    int32_t block[2 * outputBlock];
     static_cast<T *>(this)->nativePreGenerate();
-    for(size_t i = 0; i < frames; ++i)
+    while(frames > 0)
     {
-        int32_t frame[2];
-        static_cast<T *>(this)->resampledGenerate(frame);
-        for (unsigned c = 0; c < 2; ++c) {
-            int32_t temp = (int32_t)output[c] + frame[c];
+        size_t count = (frames < (size_t)outputBlock) ? frames : (size_t)outputBlock;
+        queuedGenerateN(block, count);
+        for(size_t i = 0; i < 2 * count; ++i)
+        {
+            int32_t temp = (int32_t)output[i] + block[i];
             temp = (temp > -32768) ? temp : -32768;
             temp = (temp < 32767) ? temp : 32767;
-            output[c] = (int16_t)temp;
+            output[i] = (int16_t)temp;
         }
-        output += 2;
+        output += 2 * count;
+        frames -= count;
     }
     static_cast<T *>(this)->nativePostGenerate();
 }
@@ -146,27 +190,53 @@ template <class T>
 void OPLChipBaseT<T>::generate32(int32_t *output, size_t frames)
 {
     static_cast<T *>(this)->nativePreGenerate();
-    for(size_t i = 0; i < frames; ++i)
+    queuedGenerateN(output, frames);
+    static_cast<T *>(this)->nativePostGenerate();
+}
+
+template <class T>
+void OPLChipBaseT<T>::generateAndMix32(int32_t *output, size_t frames)
+{
+    int32_t block[2 * outputBlock];
+    static_cast<T *>(this)->nativePreGenerate();
+    while(frames > 0)
     {
-        static_cast<T *>(this)->resampledGenerate(output);
-        output += 2;
+        size_t count = (frames < (size_t)outputBlock) ? frames : (size_t)outputBlock;
+        queuedGenerateN(block, count);
+        for(size_t i = 0; i < 2 * count; ++i)
+            output[i] += block[i];
+        output += 2 * count;
+        frames -= count;
     }
     static_cast<T *>(this)->nativePostGenerate();
 }
 
 template <class T>
-void OPLChipBaseT<T>::generateAndMix32(int32_t *output, size_t frames)
+void OPLChipBaseT<T>::generateFloat(float *output, size_t frames)
 {
+    int32_t block[2 * outputBlock];
+    const float scale = 1.0f / 32768.0f;
     static_cast<T *>(this)->nativePreGenerate();
+    while(frames > 0)
+    {
+        size_t count = (frames < (size_t)outputBlock) ? frames : (size_t)outputBlock;
+        queuedGenerateN(block, count);
+        for(size_t i = 0; i < 2 * count; ++i)
+            output[i] = (float)block[i] * scale;
+        output += 2 * count;
+        frames -= count;
+    }
+    static_cast<T *>(this)->nativePostGenerate();
+}
+
+template <class T>
+void OPLChipBaseT<T>::nativeGenerateN(int16_t *output, size_t frames)
+{
     for(size_t i = 0; i < frames; ++i)
     {
-        int32_t frame[2];
-        static_cast<T *>(this)->resampledGenerate(frame);
-        output[0] += frame[0];
-        output[1] += frame[1];
+        static_cast<T *>(this)->nativeGenerate(output);
         output += 2;
     }
-    static_cast<T *>(this)->nativePostGenerate();
 }
 
 template <class T>
@@ -178,16 +248,71 @@ void OPLChipBaseT<T>::nativeTick(int16_t *frame)
     static_cast<T *>(this)->nativeGenerate(frame);
 }
 
+template <class T>
+void OPLChipBaseT<T>::nativeTickN(int16_t *output, size_t frames)
+{
+#if defined(ADLMIDI_AUDIO_TICK_HANDLER)
+    // The tick handler must be called on every native frame
+    for(size_t i = 0; i < frames; ++i)
+    {
+        nativeTick(output);
+        output += 2;
+    }
+#else
+    static_cast<T *>(this)->nativeGenerateN(output, frames);
+#endif
+}
+
+template <class T>
+void OPLChipBaseT<T>::applyDueWrites()
+{
+    while(m_writeQueueCount > 0)
+    {
+        const QueuedWrite &w = m_writeQueue[m_writeQueueHead];
+        if((int32_t)(w.time - m_writeClock) > 0)
+            break;
+        static_cast<T *>(this)->writeReg(w.addr, w.data);
+        m_writeQueueHead = (m_writeQueueHead + 1) % writeQueueSize;
+        --m_writeQueueCount;
+    }
+}
+
+template <class T>
+void OPLChipBaseT<T>::queuedGenerateN(int32_t *output, size_t frames)
+{
+    while(frames > 0)
+    {
+        size_t count = frames;
+
+        // Render the whole run until the next queued write
+        applyDueWrites();
+        if(m_writeQueueCount > 0)
+        {
+            uint32_t due = m_writeQueue[m_writeQueueHead].time - m_writeClock;
+            if(due < count)
+                count = due;
+        }
+
+        resampledGenerateN(output, count);
+        m_writeClock += (uint32_t)count;
+        output += 2 * count;
+        frames -= count;
+    }
+}
+
 template <class T>
 void OPLChipBaseT<T>::setupResampler(uint32_t rate)
 {
 #if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-    m_resampler->setup(rate * (1.0 / 49716), 2, 48);
+    m_resampler.setup(49716, rate);
 #else
     m_oldsamples[0] = m_oldsamples[1] = 0;
     m_samples[0] = m_samples[1] = 0;
     m_samplecnt = 0;
     m_rateratio = (int32_t)((rate << rsm_frac) / 49716);
+    linearRsmSetupDivider(&m_rsmDivider,
+                          m_rateratio * T::resamplerPostAttenuate,
+                          (uint64_t)32768 * T::resamplerPreAmplify * (uint64_t)m_rateratio);
 #endif
 }
 
@@ -195,7 +320,7 @@ template <class T>
 void OPLChipBaseT<T>::resetResampler()
 {
 #if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-    m_resampler->reset();
+    m_resampler.reset();
 #else
     m_oldsamples[0] = m_oldsamples[1] = 0;
     m_samples[0] = m_samples[1] = 0;
@@ -207,42 +332,53 @@ void OPLChipBaseT<T>::resetResampler()
 template <class T>
 void OPLChipBaseT<T>::resampledGenerate(int32_t *output)
 {
+    queuedGenerateN(output, 1);
+}
+
+template <class T>
+void OPLChipBaseT<T>::resampledGenerateN(int32_t *output, size_t frames)
+{
+    int16_t *native = m_nativeBuffer;
+
     if(UNLIKELY(m_runningAtPcmRate))
     {
-        int16_t in[2];
-        static_cast<T *>(this)->nativeTick(in);
-        output[0] = (int32_t)in[0] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
-        output[1] = (int32_t)in[1] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
+        while(frames > 0)
+        {
+            size_t count = (frames < (size_t)nativeBlock) ? frames : (size_t)nativeBlock;
+            nativeTickN(native, count);
+            for(size_t i = 0; i < 2 * count; ++i)
+                output[i] = (int32_t)native[i] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
+            output += 2 * count;
+            frames -= count;
+        }
         return;
     }
 
-    VResampler *rsm = m_resampler;
+    PolyphaseResampler &rsm = m_resampler;
     float scale = (float)T::resamplerPreAmplify /
         (float)T::resamplerPostAttenuate;
-    float f_in[2];
-    float f_out[2];
-    rsm->inp_count = 0;
-    rsm->inp_data = f_in;
-    rsm->out_count = 1;
-    rsm->out_data = f_out;
-    while(rsm->process(), rsm->out_count != 0)
+
+    while(frames > 0)
     {
-        int16_t in[2];
-        static_cast<T *>(this)->nativeTick(in);
-        f_in[0] = scale * (float)in[0];
-        f_in[1] = scale * (float)in[1];
-        rsm->inp_count = 1;
-        rsm->inp_data = f_in;
-        rsm->out_count = 1;
-        rsm->out_data = f_out;
+        // Take as many output frames as one block of native frames can give
+        size_t count = rsm.outputFramesFor(nativeBlock);
+        if(count > frames)
+            count = frames;
+        size_t nativeCount = rsm.inputFramesFor(count);
+
+        nativeTickN(native, nativeCount);
+        rsm.process(native, output, count, scale);
+        output += 2 * count;
+        frames -= count;
     }
-    output[0] = static_cast<int32_t>(lround(f_out[0]));
-    output[1] = static_cast<int32_t>(lround(f_out[1]));
 }
 #else
 template <class T>
 void OPLChipBaseT<T>::resampledGenerate(int32_t *output)
 {
+    applyDueWrites();
+    ++m_writeClock;
+
     if(UNLIKELY(m_runningAtPcmRate))
     {
         int16_t in[2];
@@ -270,6 +406,62 @@ void OPLChipBaseT<T>::resampledGenerate(int32_t *output)
                             + m_samples[1] * samplecnt) / rateratio)/T::resamplerPostAttenuate);
     m_samplecnt = samplecnt + (1 << rsm_frac);
 }
+
+template <class T>
+void OPLChipBaseT<T>::resampledGenerateN(int32_t *output, size_t frames)
+{
+    int16_t *native = m_nativeBuffer;
+
+    if(UNLIKELY(m_runningAtPcmRate))
+    {
+        while(frames > 0)
+        {
+            size_t count = (frames < (size_t)nativeBlock) ? frames : (size_t)nativeBlock;
+            nativeTickN(native, count);
+            for(size_t i = 0; i < 2 * count; ++i)
+                output[i] = (int32_t)native[i] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
+            output += 2 * count;
+            frames -= count;
+        }
+        return;
+    }
+
+    const int32_t rateratio = m_rateratio;
+    int32_t *buffer = m_rsmBuffer;
+
+    while(frames > 0)
+    {
+        int32_t samplecnt = m_samplecnt;
+
+        // The output frame N consumes floor((samplecnt + N * step) / rateratio)
+        // native frames in total: take as many output frames as one block of
+        // native frames can give, then render that block at once.
+        size_t count = (size_t)(((int64_t)(nativeBlock + 1) * rateratio - 1 - samplecnt) >> rsm_frac) + 1;
+        if(count > frames)
+            count = frames;
+        size_t nativeCount = (size_t)(((int64_t)samplecnt + ((int64_t)(count - 1) << rsm_frac)) / rateratio);
+
+        nativeTickN(native, nativeCount);
+
+        buffer[0] = m_oldsamples[0];
+        buffer[1] = m_oldsamples[1];
+        buffer[2] = m_samples[0];
+        buffer[3] = m_samples[1];
+        for(size_t i = 0; i < 2 * nativeCount; ++i)
+            buffer[4 + i] = native[i] * T::resamplerPreAmplify;
+
+        const int32_t *in = linearRsmProcess(buffer, output, count, &samplecnt,
+                                             rateratio, 1 << rsm_frac, m_rsmDivider);
+        output += 2 * count;
+
+        m_oldsamples[0] = in[0];
+        m_oldsamples[1] = in[1];
+        m_samples[0] = in[2];
+        m_samples[1] = in[3];
+        m_samplecnt = samplecnt;
+        frames -= count;
+    }
+}
 #endif
 
 /* OPLChipBaseBufferedT */
@@ -26,7 +26,8 @@ YmFmOPL2::YmFmOPL2() :
     OPLChipBaseT(),
     m_headPos(0),
     m_tailPos(0),
-    m_queueCount(0)
+    m_queueCount(0),
+    m_drainLimit(0)
 {
     ymfm::ymfm_interface* intf = new ymfm::ymfm_interface;
     m_intf = intf;
@@ -52,12 +53,24 @@ void YmFmOPL2::setRate(uint32_t rate)
 void YmFmOPL2::reset()
 {
     OPLChipBaseT::reset();
+    m_headPos = 0;
+    m_tailPos = 0;
+    m_queueCount = 0;
     ymfm::ym3812 *chip_r = reinterpret_cast<ymfm::ym3812*>(m_chip);
     chip_r->reset();
 }
 
 void YmFmOPL2::writeReg(uint16_t addr, uint8_t data)
 {
+    if(m_queueCount >= (long)c_queueSize)
+    {
+        // The queue is full: spill the oldest write into the chip right now
+        applyWrite(m_queue[m_tailPos++]);
+        if(m_tailPos >= c_queueSize)
+            m_tailPos = 0;
+        --m_queueCount;
+    }
+
     Reg &back = m_queue[m_headPos++];
     back.addr = addr;
     back.data = data;
@@ -68,41 +81,87 @@ void YmFmOPL2::writeReg(uint16_t addr, uint8_t data)
     ++m_queueCount;
 }
 
-void YmFmOPL2::nativeGenerate(int16_t *frame)
+void YmFmOPL2::setWriteDrainLimit(unsigned count)
+{
+    m_drainLimit = count;
+}
+
+void YmFmOPL2::applyWrite(const Reg &reg)
 {
     ymfm::ym3812 *chip_r = reinterpret_cast<ymfm::ym3812*>(m_chip);
-    ymfm::ym3812::output_data frames_i;
+    uint16_t addr1 = 0 + 2 * ((reg.addr >> 8) & 3);
+    chip_r->write(addr1, reg.addr & 0xff);
+    chip_r->write(addr1 + 1, reg.data);
+}
 
-    uint16_t addr1 = 0xffff, addr2 = 0xffff;
-    uint8_t data1 = 0, data2 = 0;
+void YmFmOPL2::drainWrites()
+{
+    // see if there is data to be written; if so, extract it and dequeue.
+    // A register written twice waits for the next sample, so that the chip
+    // sees every value (like the key-off just before the key-on).
+    uint32_t written[512 / 32];
+    long count = 0;
 
-    // see if there is data to be written; if so, extract it and dequeue
-    if(m_queueCount > 0)
+    std::memset(written, 0, sizeof(written));
+
+    while(m_queueCount > 0 && (m_drainLimit == 0 || count < (long)m_drainLimit))
     {
-        const Reg &front = m_queue[m_tailPos++];
+        const Reg &front = m_queue[m_tailPos];
+        uint32_t bit = 1u << (front.addr & 31);
+        uint32_t &word = written[(front.addr >> 5) & 15];
 
-        if(m_tailPos >= c_queueSize)
+        if(word & bit)
+            break;
+        word |= bit;
+
+        applyWrite(front);
+        if(++m_tailPos >= c_queueSize)
             m_tailPos = 0;
         --m_queueCount;
-
-        addr1 = 0 + 2 * ((front.addr >> 8) & 3);
-        data1 = front.addr & 0xff;
-        addr2 = addr1 + 1;
-        data2 = front.data;
+        ++count;
     }
+}
 
-    // write to the chip
-    if(addr1 != 0xffff)
-    {
-        chip_r->write(addr1, data1);
-        chip_r->write(addr2, data2);
-    }
+void YmFmOPL2::nativeGenerate(int16_t *frame)
+{
+    ymfm::ym3812 *chip_r = reinterpret_cast<ymfm::ym3812*>(m_chip);
+    ymfm::ym3812::output_data frames_i;
+
+    if(m_queueCount > 0)
+        drainWrites();
 
     chip_r->generate(&frames_i);
     frame[0] = static_cast<int16_t>(ymfm::clamp(frames_i.data[0], -32768, 32767));
     frame[1] = frame[0];
 }
 
+void YmFmOPL2::nativeGenerateN(int16_t *output, size_t frames)
+{
+    ymfm::ym3812 *chip_r = reinterpret_cast<ymfm::ym3812*>(m_chip);
+    ymfm::ym3812::output_data frames_i[256];
+
+    // Writes still held back by the drain limit are paced sample by sample
+    while(frames > 0 && m_queueCount > 0)
+    {
+        nativeGenerate(output);
+        output += 2;
+        --frames;
+    }
+
+    while(frames > 0)
+    {
+        uint32_t count = (frames < 256) ? (uint32_t)frames : 256;
+        chip_r->generate(frames_i, count);
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            output[0] = static_cast<int16_t>(ymfm::clamp(frames_i[i].data[0], -32768, 32767));
+            output[1] = output[0];
+            output += 2;
+        }
+        frames -= count;
+    }
+}
+
 const char *YmFmOPL2::emulatorName()
 {
     return "YMFM OPL2";
@@ -40,6 +40,10 @@ class YmFmOPL3 final : public OPLChipBaseT<YmFmOPL3>
     size_t m_headPos;
     size_t m_tailPos;
     long m_queueCount;
+    unsigned m_drainLimit;
+
+    void applyWrite(const Reg &reg);
+    void drainWrites();
 
 public:
     YmFmOPL3();
@@ -49,9 +53,16 @@ public:
     void setRate(uint32_t rate) override;
     void reset() override;
     void writeReg(uint16_t addr, uint8_t data) override;
+    /**
+     * @brief Set how many queued writes get applied before every generated sample
+     * @param count Count of writes, or 0 to apply all pending writes at once (default),
+     *        a write into the same register always waits for the next sample
+     */
+    void setWriteDrainLimit(unsigned count);
     void nativePreGenerate() override {}
     void nativePostGenerate() override {}
     void nativeGenerate(int16_t *frame) override;
+    void nativeGenerateN(int16_t *output, size_t frames);
     const char *emulatorName() override;
     ChipType chipType() override;
     bool hasFullPanning() override;
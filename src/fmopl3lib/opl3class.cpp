@@ -13,6 +13,7 @@
 //
 
 #include "opl3class.h"
+#include <string.h>
 
 #ifndef HW_DOS_BUILD
 #include "../emu_list.h"
@@ -41,8 +42,19 @@ void set_chip_hw_address(unsigned short addr)
 }
 #endif
 
+// Registers which do something on every write, even of the same value
+static inline bool regHasSideEffects(unsigned short reg)
+{
+    unsigned int r = reg & 0xff;
+    return (r >= 0x02 && r <= 0x04) ||  // Timers and their control
+           (r >= 0xB0 && r <= 0xB8) ||  // Key-on
+           r == 0xBD;                   // Rhythm mode key-on
+}
+
 opl3class::opl3class() : fm_chip()
-{}
+{
+    shadowReset();
+}
 
 opl3class::~opl3class()
 {
@@ -108,15 +120,52 @@ int opl3class::fm_init(int chip_emu, unsigned int rate) {
 
     chip->setChipId(0);
     chip->setRate(rate);
+    m_shadowAliased = chip->chipType() != OPLChipBase::CHIPTYPE_OPL3;
 #else
     (void)chip_emu;
     (void)rate;
 #endif
 
+    shadowReset();
+    m_writes = 0;
+    m_writesElided = 0;
+
     return 1;
 }
 
+void opl3class::shadowReset()
+{
+    memset(m_shadowValid, 0, sizeof(m_shadowValid));
+}
+
 void opl3class::fm_writereg(unsigned short reg, unsigned char data) {
+    unsigned int r = reg & 0x1ff;
+    unsigned char bit = 1 << (r & 7);
+
+    ++m_writes;
+
+    if((m_shadowValid[r >> 3] & bit) && m_shadow[r] == data)
+    {
+        ++m_writesElided;
+        return;
+    }
+
+    if(!regHasSideEffects(reg))
+    {
+        m_shadow[r] = data;
+        m_shadowValid[r >> 3] |= bit;
+    }
+
+    if(m_shadowAliased)
+    {
+        r ^= 0x100;
+        m_shadowValid[r >> 3] &= ~(1 << (r & 7));
+    }
+
+    chipWrite(reg, data);
+}
+
+void opl3class::chipWrite(unsigned short reg, unsigned char data) {
 #ifndef HW_DOS_BUILD
     chip->writeReg(reg, data);
 #else
@@ -133,6 +182,29 @@ void opl3class::fm_writereg(unsigned short reg, unsigned char data) {
 #endif
 }
 
+void opl3class::fm_writereg_at(unsigned int offset, unsigned short reg, unsigned char data) {
+#ifndef HW_DOS_BUILD
+    unsigned int r = reg & 0x1ff;
+
+    // Delayed writes may land in any order relatively to the immediate ones,
+    // the shadow value of this register (and of its mirror) becomes unknown
+    ++m_writes;
+    m_shadowValid[r >> 3] &= ~(1 << (r & 7));
+    r ^= 0x100;
+    m_shadowValid[r >> 3] &= ~(1 << (r & 7));
+    chip->writeRegAt(offset, reg, data);
+#else
+    // The real chip plays on its own, there is nothing to delay
+    (void)offset;
+    fm_writereg(reg, data);
+#endif
+}
+
+void opl3class::fm_write_stats(unsigned long *writes, unsigned long *elided) {
+    *writes = m_writes;
+    *elided = m_writesElided;
+}
+
 #ifndef HW_DOS_BUILD
 inline int32_t adl_cvtS16(int32_t x)
 {
@@ -154,9 +226,13 @@ void opl3class::fm_generate(int *buffer, unsigned int len) {
         ++buffer;
     }
 }
+
+void opl3class::fm_generate_float(float *buffer, unsigned int len) {
+    chip->generateFloat(buffer, len);
+}
 #endif
 
-fm_chip *getchip() {
+fm_chip *fm_chip::create() {
     opl3class *chip = new opl3class;
     return chip;
 }
@@ -24,6 +24,17 @@ private:
 #ifndef HW_DOS_BUILD
     OPLChipBase *chip = nullptr;
 #endif
+    // Last values written into every register, used to skip redundant writes
+    unsigned char m_shadow[512];
+    // Bit per register: the shadow value is known
+    unsigned char m_shadowValid[512 / 8];
+    // The chip may mirror the second register array onto the first one
+    bool m_shadowAliased = true;
+    unsigned long m_writes = 0;
+    unsigned long m_writesElided = 0;
+
+    void shadowReset();
+    void chipWrite(unsigned short reg, unsigned char data);
 public:
     opl3class();
     ~opl3class();
@@ -32,7 +43,10 @@ public:
 
     int fm_init(int chip_emu, unsigned int rate);
     void fm_writereg(unsigned short reg, unsigned char data);
+    void fm_writereg_at(unsigned int offset, unsigned short reg, unsigned char data);
+    void fm_write_stats(unsigned long *writes, unsigned long *elided);
 #ifndef HW_DOS_BUILD
     void fm_generate(int *buffer, unsigned int length);
+    void fm_generate_float(float *buffer, unsigned int length);
 #endif
 };
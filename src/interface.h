@@ -12,6 +12,9 @@
 // GNU General Public License for more details.
 //
 
+#ifndef INTERFACE_H
+#define INTERFACE_H
+
 class fm_chip
 {
 #if defined(__DJGPP__)
@@ -22,12 +25,20 @@ public:
     fm_chip() = default;
     virtual ~fm_chip() = default;
 
+    // Create the new independent chip instance
+    static fm_chip *create();
+
     virtual const char *getEmuName() = 0;
 
     virtual int fm_init(int chip_emu, unsigned int rate) = 0;
     virtual void fm_writereg(unsigned short reg, unsigned char data) = 0;
+    // Write which gets applied after the given count of frames of the next generated block
+    virtual void fm_writereg_at(unsigned int offset, unsigned short reg, unsigned char data) = 0;
+    // Count of register writes requested, and of ones skipped as the chip already holds the value
+    virtual void fm_write_stats(unsigned long *writes, unsigned long *elided) = 0;
 #ifndef HW_DOS_BUILD
     virtual void fm_generate(int *buffer, unsigned int length) = 0;
+    virtual void fm_generate_float(float *buffer, unsigned int length) = 0;
 #endif
 
 #if defined(__DJGPP__)
@@ -36,6 +47,34 @@ public:
 #endif
 };
 
+// Setup of the synth instance, applied on the next midi_init()
+struct midisynth_options
+{
+    // Path to the bank file
+    const char *bank_path = nullptr;
+    // DMX driver setup, the same format as DMXOPTION environment variable has
+    const char *setup = nullptr;
+    // Print the debug messages into stdout
+    bool verbose = false;
+    // Count of chips to spread the voices over, each one rendered by its own
+    // thread. The stock DMX allocation uses one chip.
+    unsigned int chips = 1;
+    // Path to the VGM file to record every register write into, written when
+    // the synth gets destroyed or initialized again
+    const char *capture_path = nullptr;
+};
+
+// Channel event of the batch
+struct midisynth_event
+{
+    // MIDI status without the channel: 0x80 - note off, 0x90 - note on, 0xA0 - note aftertouch,
+    // 0xB0 - controller, 0xC0 - program change, 0xD0 - channel aftertouch, 0xE0 - pitch bend
+    unsigned char type;
+    unsigned char channel;
+    // Data bytes in the order of the MIDI message (the pitch bend gives LSB first)
+    unsigned char data[2];
+};
+
 class midisynth
 {
 #if defined(__DJGPP__)
@@ -46,13 +85,14 @@ public:
     midisynth() = default;
     virtual ~midisynth() = default;
 
+    // Create the new independent synth instance with its own chip
+    static midisynth *create();
+
     virtual int midi_init(int emu_type, unsigned int rate) = 0;
 
     virtual const char *getEmuName() = 0;
 
-    virtual void ignore_env(bool ignore) = 0;
-    virtual void setup_string(const char *setup) = 0;
-    virtual bool load_bank_file(const char *bank_path) = 0;
+    virtual void set_options(const midisynth_options &options) = 0;
 
     virtual void midi_write(unsigned int data) = 0;
 
@@ -65,9 +105,16 @@ public:
     virtual void midi_controller(unsigned char chan, unsigned char type, unsigned char value) = 0;
     virtual void midi_pitch_bend(unsigned char chan, unsigned char msb, unsigned char lsb) = 0;
     virtual void midi_program_change(unsigned char chan, unsigned char value) = 0;
+    // Register write straight into the chip, for the songs made of OPL data (IMF, KLM)
+    virtual void midi_raw_opl(unsigned char reg, unsigned char value) = 0;
+    // Events happened at once, each one delayed by the given count of frames into
+    // the next generated block (no delays when the sample_offsets is null)
+    virtual void midi_write_batch(const midisynth_event *events, unsigned int count, const unsigned int *sample_offsets) = 0;
 
 #ifndef HW_DOS_BUILD
     virtual void midi_generate(int *buffer, unsigned int length) = 0;
+    // Normalized output, the [-1, 1] range is the full scale
+    virtual void midi_generate_float(float *buffer, unsigned int length) = 0;
 #endif
 #if defined(__DJGPP__)
 public:
@@ -75,9 +122,8 @@ public:
 #endif
 };
 
-midisynth* getsynth();
-fm_chip* getchip();
-
 #ifdef __DJGPP__
 extern void set_chip_hw_address(unsigned short addr);
 #endif
+
+#endif // INTERFACE_H
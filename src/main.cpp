@@ -558,9 +558,11 @@ struct Args
 #ifndef HW_DOS_BUILD
     int emu_type = EMU_NUKED_OPL3;
     float gain = 2.0f;
+    unsigned int chips = 1;
     bool wave = false;
     const char *waveFile = nullptr;
     char wavePath[2048] = "";
+    const char *captureFile = nullptr;
 #endif
 
     bool loop = false;
@@ -752,6 +754,10 @@ struct Args
                 return printArgNoSup("-gain");
             else if(!std::strcmp(cur, "-towave"))
                 return printArgNoSup("-towave");
+            else if(!std::strcmp(cur, "-chips"))
+                return printArgNoSup("-chips");
+            else if(!std::strcmp(cur, "-capture"))
+                return printArgNoSup("-capture");
 #else
             else if(!std::strcmp(cur, "-freq"))
                 return printArgNoSup("-freq");
@@ -763,6 +769,20 @@ struct Args
 
                 gain = std::atof(a.arg());
             }
+            else if(!std::strcmp(cur, "-chips"))
+            {
+                a.shift();
+                if(a.end())
+                    return printArgFail(cur);
+
+                chips = std::strtoul(a.arg(), NULL, 0);
+                if(chips == 0)
+                {
+                    s_fprintf(stderr, "The option -chips requires a non-zero integer argument!\n");
+                    flushout(stderr);
+                    return false;
+                }
+            }
             else if(!std::strcmp(cur, "-wave"))
             {
                 a.shift();
@@ -778,6 +798,14 @@ struct Args
                 wave = true;
                 loop = false;
             }
+            else if(!std::strcmp(cur, "-capture"))
+            {
+                a.shift();
+                if(a.end())
+                    return printArgFail(cur);
+
+                captureFile = a.arg();
+            }
             else if(!std::strcmp(cur, "-emu"))
             {
                 a.shift();
@@ -867,10 +895,12 @@ int main(int argc, char **argv)
             "USAGE:\n\n"
             "  dmxplay [options] <filename>\n"
             "\n"
-            "  <filename>       - Path to music file to play. Required.\n"
+            "  <filename>       - Path to music file to play, or to the VGM register log\n"
+            "                     to replay into the chip with no synth. Required.\n"
             "\n"
             "Supported options:\n"
-            "  -bank <file.op2> - Path to custom OP2 bank file.\n"
+            "  -bank <file.op2> - Path to custom OP2 bank file, or to the WAD file\n"
+            "                     containing the GENMIDI lump.\n"
             "  -loop            - Enable looping of the opened music file.\n"
             "  -emidi           - Enables handling of MIDI files as Apogee Sound \n"
             "                     System EMIDI\n"
@@ -885,6 +915,10 @@ int main(int argc, char **argv)
             "  -emu <name>      - [Non-DOS ONLY] Select playback chip emulator:\n"
             "                     nuked, nuked-fast, nuked-cqm, nuked-opl2, dosbox, java, opal,\n"
             "                     ymfm-opl2, ymfm-opl3, mame-opl2, lle-opl2, lle-opl3\n"
+            "  -chips <count>   - [Non-DOS ONLY] Spread voices over several chips, each one\n"
+            "                     rendered by its own thread (by default one chip, up to 8).\n"
+            "  -capture <file>  - [Non-DOS ONLY] Record every register write of the synth\n"
+            "                     into the VGM file (with -chips up to 2).\n"
 #endif
             "  -song <NUM>      - Select song to play from 0 to N-1 (XMI only).\n"
             "  -solo <TRACK>    - Set MIDI track number to play solo.\n"
@@ -921,9 +955,13 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    // The explicit setup takes precedence over the environment
+    if(!args.setup && !args.noEnv)
+        args.setup = std::getenv("DMXOPTION");
+
     player.openBank(args.bank);
-    player.setIgnoreEnv(args.noEnv);
     player.setSetupString(args.setup);
+    player.setSynthVerbose(true);
     player.setLoop(args.loop);
     player.setModeEMIDI(args.emidi);
 
@@ -976,6 +1014,14 @@ int main(int argc, char **argv)
     flushout(stdout);
 
     player.setGain(args.gain);
+    player.setSynthChips(args.chips);
+
+    if(args.captureFile)
+    {
+        s_fprintf(stdout, " - Recording register log into %s\n", args.captureFile);
+        flushout(stdout);
+        player.setCaptureFile(args.captureFile);
+    }
 #else
     if(!oplChipInit(args.hw_addr))
     {
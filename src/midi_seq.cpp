@@ -26,6 +26,10 @@
 // Inlucde MIDI sequencer class implementation
 #include "seq/midi_sequencer_impl.hpp"
 #include "midi_seq.h"
+#ifndef HW_DOS_BUILD
+#   include "pcm_convert.h"
+#   include "synthlib/opl_log.h"
+#endif
 
 // Synth interface
 #include "interface.h"
@@ -109,12 +113,35 @@ static void rtSongBegin(void *userdata)
     context->midi_reset();
 }
 
+static void rtRawOPL(void *userdata, uint8_t reg, uint8_t value)
+{
+    midisynth *context = reinterpret_cast<midisynth *>(userdata);
+    context->midi_raw_opl(reg, value);
+}
+
+static void rtEventBatch(void *userdata, const BW_MidiRtEvent *events, size_t count, const uint32_t *sampleOffsets)
+{
+    // Both structures describe the same event, byte per field
+    static_assert(sizeof(BW_MidiRtEvent) == sizeof(midisynth_event), "Batch event layouts mismatch");
+    static_assert(sizeof(uint32_t) == sizeof(unsigned int), "Batch offsets layouts mismatch");
+    midisynth *context = reinterpret_cast<midisynth *>(userdata);
+    context->midi_write_batch(reinterpret_cast<const midisynth_event *>(events),
+                              static_cast<unsigned int>(count),
+                              reinterpret_cast<const unsigned int *>(sampleOffsets));
+}
+
 #ifndef HW_DOS_BUILD
 static void playSynth(void *userdata, uint8_t *stream, size_t length)
 {
     midisynth *context = reinterpret_cast<midisynth *>(userdata);
     context->midi_generate(reinterpret_cast<int*>(stream), length / (2 * sizeof(int)));
 }
+
+static void playSynthFloat(void *userdata, uint8_t *stream, size_t length)
+{
+    midisynth *context = reinterpret_cast<midisynth *>(userdata);
+    context->midi_generate_float(reinterpret_cast<float*>(stream), length / (2 * sizeof(float)));
+}
 #endif
 
 #ifdef HW_DOS_BUILD
@@ -137,6 +164,8 @@ void MIDI_Seq::initSeq()
     m_interface->rt_patchChange = rtPatchChange;
     m_interface->rt_pitchBend = rtPitchBend;
     m_interface->rt_systemExclusive = rtSysEx;
+    m_interface->rt_rawOPL = rtRawOPL;
+    m_interface->rt_eventBatch = rtEventBatch;
 
     m_interface->onSongStart = rtSongBegin;
     m_interface->onSongStart_userData = m_synth;
@@ -176,7 +205,7 @@ void MIDI_Seq::debugMessageHook(void */*userdata*/, const char *fmt, ...)
 }
 
 MIDI_Seq::MIDI_Seq() :
-    m_synth(getsynth()),
+    m_synth(midisynth::create()),
     m_interface(new BW_MidiRtInterface),
     m_sequencer(new BW_MidiSequencer)
 {
@@ -193,6 +222,8 @@ MIDI_Seq::~MIDI_Seq()
 #ifndef HW_DOS_BUILD
     if(m_stream)
         SDL_FreeAudioStream(m_stream);
+
+    delete m_log;
 #endif
 
 #ifdef HW_DOS_BUILD
@@ -218,27 +249,53 @@ void MIDI_Seq::set_hw_addr(unsigned short addr)
 bool MIDI_Seq::initStream(int out_fmt, int out_rate, int out_channels)
 {
     if(m_stream)
+    {
         SDL_FreeAudioStream(m_stream);
+        m_stream = nullptr;
+    }
 
     m_output_format = out_fmt;
-    m_stream = SDL_NewAudioStream(AUDIO_S32SYS, 2, m_rate, out_fmt, out_channels, out_rate);
+
+    // Float devices take the synth's normalized output with no integer stage.
+    // Both kinds of frames have the same size, only the renderer changes.
+    m_float_render = (out_fmt == AUDIO_F32SYS);
+    m_interface->onPcmRender = m_float_render ? playSynthFloat : playSynth;
+
+    // The synth already renders at the device rate. When the device also takes
+    // stereo frames, write them into the output directly rather than passing
+    // them through the SDL's converter again.
+    if(out_rate == static_cast<int>(m_rate) && out_channels == 2)
+    {
+        m_output_frame_size = 2 * pcmSampleSize(out_fmt);
+        return true;
+    }
+
+    // Otherwise the stream only remixes channels and changes the rate,
+    // the gain and the format conversion are applied on its output.
+    m_output_frame_size = 0;
+    const SDL_AudioFormat synth_fmt = m_float_render ? AUDIO_F32SYS : AUDIO_S32SYS;
+    m_stream = SDL_NewAudioStream(synth_fmt, 2, m_rate, synth_fmt, out_channels, out_rate);
     return m_stream != nullptr;
 }
 #endif
 
-void MIDI_Seq::setIgnoreEnv(bool ignore)
+void MIDI_Seq::setSetupString(const char *setup)
 {
-    m_synth->ignore_env(ignore);
+    m_synth_options.setup = setup;
+    m_synth->set_options(m_synth_options);
 }
 
-void MIDI_Seq::setSetupString(const char *setup)
+void MIDI_Seq::setSynthVerbose(bool verbose)
 {
-    m_synth->setup_string(setup);
+    m_synth_options.verbose = verbose;
+    m_synth->set_options(m_synth_options);
 }
 
 bool MIDI_Seq::openBank(const char *bank)
 {
-    return m_synth->load_bank_file(bank);
+    m_synth_options.bank_path = bank;
+    m_synth->set_options(m_synth_options);
+    return true;
 }
 
 bool MIDI_Seq::openMusic(const char *music)
@@ -246,6 +303,18 @@ bool MIDI_Seq::openMusic(const char *music)
     if(!music)
         return false;
 
+#ifndef HW_DOS_BUILD
+    delete m_log;
+    m_log = nullptr;
+
+    if(OPLLogPlayer::isLog(music))
+    {
+        m_log = new OPLLogPlayer;
+        m_log->setLoop(m_loop);
+        return m_log->open(music) && m_log->init(m_emu_type, m_rate);
+    }
+#endif
+
     return m_sequencer->loadMIDI(music);
 }
 
@@ -254,12 +323,25 @@ void MIDI_Seq::setGain(float gain)
 {
     m_gain = gain;
 }
+
+void MIDI_Seq::setSynthChips(unsigned int chips)
+{
+    m_synth_options.chips = chips;
+    m_synth->set_options(m_synth_options);
+}
+
+void MIDI_Seq::setCaptureFile(const char *path)
+{
+    m_synth_options.capture_path = path;
+    m_synth->set_options(m_synth_options);
+}
 #endif
 
 int MIDI_Seq::initSynth(int emu_type, unsigned int rate)
 {
 #ifndef HW_DOS_BUILD
     m_rate = rate;
+    m_emu_type = emu_type;
 #endif
     initSeq();
     return m_synth->midi_init(emu_type, rate);
@@ -267,11 +349,20 @@ int MIDI_Seq::initSynth(int emu_type, unsigned int rate)
 
 const char *MIDI_Seq::getEmuName()
 {
+#ifndef HW_DOS_BUILD
+    if(m_log)
+        return m_log->getEmuName();
+#endif
     return m_synth->getEmuName();
 }
 
 void MIDI_Seq::setLoop(bool enable)
 {
+#ifndef HW_DOS_BUILD
+    m_loop = enable;
+    if(m_log)
+        m_log->setLoop(enable);
+#endif
     m_sequencer->setLoopEnabled(enable);
 }
 
@@ -340,6 +431,13 @@ void MIDI_Seq::prevSong()
 
 void MIDI_Seq::rewind()
 {
+#ifndef HW_DOS_BUILD
+    if(m_log)
+    {
+        m_log->rewind();
+        return;
+    }
+#endif
     m_sequencer->rewind();
 }
 
@@ -350,26 +448,46 @@ double MIDI_Seq::tick(double s, double granularity)
 
 double MIDI_Seq::tell()
 {
+#ifndef HW_DOS_BUILD
+    if(m_log)
+        return m_log->tell();
+#endif
     return m_sequencer->tell();
 }
 
 double MIDI_Seq::duration()
 {
+#ifndef HW_DOS_BUILD
+    if(m_log)
+        return m_log->duration();
+#endif
     return m_sequencer->timeLength();
 }
 
 double MIDI_Seq::loopStart()
 {
+#ifndef HW_DOS_BUILD
+    if(m_log)
+        return m_log->loopStart();
+#endif
     return m_sequencer->getLoopStart();
 }
 
 double MIDI_Seq::loopEnd()
 {
+#ifndef HW_DOS_BUILD
+    if(m_log)
+        return m_log->loopStart() >= 0.0 ? m_log->duration() : -1.0;
+#endif
     return m_sequencer->getLoopEnd();
 }
 
 bool MIDI_Seq::atEnd()
 {
+#ifndef HW_DOS_BUILD
+    if(m_log)
+        return m_log->atEnd();
+#endif
     return m_sequencer->positionAtEnd();
 }
 
@@ -379,10 +497,75 @@ void MIDI_Seq::panic()
 }
 
 #ifndef HW_DOS_BUILD
+int MIDI_Seq::playStream(unsigned char *out, size_t len)
+{
+    if(!m_log)
+        return m_sequencer->playStream(out, len);
+
+    const size_t frame_size = 2 * sizeof(int32_t);
+    const unsigned int frames = static_cast<unsigned int>(len / frame_size);
+    unsigned int got;
+
+    if(m_float_render)
+        got = m_log->generate_float(reinterpret_cast<float *>(out), frames);
+    else
+        got = m_log->generate(reinterpret_cast<int *>(out), frames);
+
+    return static_cast<int>(got * frame_size);
+}
+
+size_t MIDI_Seq::playBufferDirect(unsigned char *out, size_t len)
+{
+    const size_t frame_size = m_output_frame_size;
+    const size_t synth_frame_size = 2 * sizeof(int32_t);
+    const size_t frames = len / frame_size;
+    size_t written = 0;
+
+    while(written < frames)
+    {
+        unsigned char *dst = out + written * frame_size;
+        unsigned char *src = dst;
+        size_t count = frames - written;
+
+        // The 32-bit samples are rendered and processed in place,
+        // the smaller ones need an intermediate buffer.
+        if(frame_size != synth_frame_size)
+        {
+            src = m_buffer;
+            if(count > m_buffer_max_size / synth_frame_size)
+                count = m_buffer_max_size / synth_frame_size;
+        }
+
+        int ret = playStream(src, count * synth_frame_size);
+        if(ret <= 0)
+            break;
+
+        size_t got = static_cast<size_t>(ret) / synth_frame_size;
+        if(m_float_render)
+            pcmGainClipFloat(reinterpret_cast<float *>(dst), got * 2, m_gain);
+        else
+            pcmGainConvert(reinterpret_cast<const int32_t *>(src), dst, got * 2, m_output_format, m_gain);
+        written += got;
+
+        if(got < count)
+            break; // Reached the song end
+    }
+
+    if(written * frame_size < len)
+        SDL_memset(out + written * frame_size, 0, len - written * frame_size);
+
+    return written * frame_size;
+}
+
 size_t MIDI_Seq::playBuffer(unsigned char *out, size_t len)
 {
+    if(!m_stream)
+        return playBufferDirect(out, len);
+
     const size_t init_len = len;
+    const size_t sample_size = pcmSampleSize(m_output_format);
     size_t out_written = 0;
+    size_t want;
     int ret, filled;
     int attempts = 0;
 
@@ -392,14 +575,27 @@ retry:
     if(len == 0 || len > init_len || attempts > 10)
         return out_written;
 
-    filled = SDL_AudioStreamGet(m_stream, m_gainBuffer, len > m_gainBuffer_max_size ? m_gainBuffer_max_size : len);
+    if(m_float_render)
+        filled = SDL_AudioStreamGet(m_stream, out, len);
+    else
+    {
+        want = (len / sample_size) * sizeof(int32_t);
+        filled = SDL_AudioStreamGet(m_stream, m_gainBuffer, want > m_gainBuffer_max_size ? m_gainBuffer_max_size : want);
+    }
 
     if(filled != 0)
     {
         if(filled < 0)
             return 0; // FAIL!
 
-        SDL_MixAudioFormat(out, m_gainBuffer, m_output_format, filled, static_cast<int>(SDL_MIX_MAXVOLUME * m_gain));
+        size_t samples = static_cast<size_t>(filled) / sizeof(int32_t);
+        if(m_float_render)
+            pcmGainClipFloat(reinterpret_cast<float *>(out), samples, m_gain);
+        else
+        {
+            pcmGainConvert(reinterpret_cast<const int32_t *>(m_gainBuffer), out, samples, m_output_format, m_gain);
+            filled = static_cast<int>(samples * sample_size);
+        }
 
         out_written += filled;
 
@@ -410,7 +606,7 @@ retry:
         len -= filled;
     }
 
-    ret = m_sequencer->playStream(m_buffer, m_buffer_max_size);
+    ret = playStream(m_buffer, m_buffer_max_size);
 
     if(ret > 0)
         SDL_AudioStreamPut(m_stream, m_buffer, ret);
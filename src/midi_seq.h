@@ -16,8 +16,8 @@
 #define MIDI_SEQ_H
 
 #include <stddef.h>
+#include "interface.h"
 
-class midisynth;
 // Rename class to avoid ABI collisions
 #define BW_MidiSequencer AdlMidiSequencer
 class BW_MidiSequencer;
@@ -27,6 +27,7 @@ typedef struct BW_MidiRtInterface BW_MidiRtInterface;
 #ifndef HW_DOS_BUILD
 struct _SDL_AudioStream;
 typedef struct _SDL_AudioStream SDL_AudioStream;
+class OPLLogPlayer;
 #endif
 
 class MIDI_Seq
@@ -40,6 +41,7 @@ private:
     BW_MidiRtInterface *m_interface = nullptr;
     MidiSequencer *m_sequencer = nullptr;
     int m_cur_song = 0;
+    midisynth_options m_synth_options;
 #ifndef HW_DOS_BUILD
     SDL_AudioStream *m_stream = nullptr;
     unsigned char m_buffer[4096];
@@ -48,12 +50,23 @@ private:
     unsigned char m_gainBuffer[4096];
     const size_t m_gainBuffer_max_size = 4096;
 
+    // Register log played instead of the music, with no sequencer and synth
+    OPLLogPlayer *m_log = nullptr;
+    int m_emu_type = 0;
+    bool m_loop = false;
+
     unsigned int m_rate = 0;
     int m_output_format = 0;
+    size_t m_output_frame_size = 0;
+    bool m_float_render = false;
     float m_gain = 2.0f;
 #endif
 
     void initSeq();
+#ifndef HW_DOS_BUILD
+    int playStream(unsigned char *out, size_t len);
+    size_t playBufferDirect(unsigned char *out, size_t len);
+#endif
 
     static void debugMessageHook(void *userdata, const char *fmt, ...);
 
@@ -67,13 +80,15 @@ public:
     void set_hw_addr(unsigned short addr);
 #endif
 
-    void setIgnoreEnv(bool ignore);
     void setSetupString(const char *setup);
+    void setSynthVerbose(bool verbose);
     bool openBank(const char *bank);
     bool openMusic(const char *music);
 
 #ifndef HW_DOS_BUILD
     void setGain(float gain);
+    void setSynthChips(unsigned int chips);
+    void setCaptureFile(const char *path);
 #endif
 
     int initSynth(int emu_type, unsigned int rate);
@@ -0,0 +1,288 @@
+//
+// Copyright(C) 2025-2026 Vitaliy Novichkov
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include <SDL2/SDL_audio.h>
+#include <cstring>
+#include "pcm_convert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define PCM_CONVERT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#   define PCM_CONVERT_NEON
+#endif
+
+/*
+ * Every sample is made as: clip(in * scale, lo, hi), then truncated to the
+ * integer (or stored as is for the float output). The scale maps the full
+ * range of the 32-bit input into the range of the output format and applies
+ * the gain at once.
+ */
+
+struct PcmLimits
+{
+    float scale;
+    float lo;
+    float hi;
+};
+
+static PcmLimits pcmLimits(int format, float gain)
+{
+    PcmLimits l;
+    int bits = SDL_AUDIO_BITSIZE(format);
+
+    if(SDL_AUDIO_ISFLOAT(format))
+    {
+        l.scale = gain / 2147483648.0f;
+        l.lo = -1.0f;
+        l.hi = 1.0f;
+    }
+    else if(bits == 32)
+    {
+        l.scale = gain;
+        l.lo = -2147483648.0f;
+        l.hi = 2147483520.0f; // The largest float below 2^31
+    }
+    else
+    {
+        l.scale = gain / static_cast<float>(1u << (32 - bits));
+        l.lo = -static_cast<float>(1 << (bits - 1));
+        l.hi = static_cast<float>((1 << (bits - 1)) - 1);
+    }
+
+    return l;
+}
+
+static inline uint16_t swap16(uint16_t x)
+{
+    return static_cast<uint16_t>((x << 8) | (x >> 8));
+}
+
+static inline uint32_t swap32(uint32_t x)
+{
+    return (x << 24) | ((x << 8) & 0x00FF0000u) | ((x >> 8) & 0x0000FF00u) | (x >> 24);
+}
+
+static inline float clipSample(int32_t x, const PcmLimits &l)
+{
+    float v = static_cast<float>(x) * l.scale;
+    v = (v > l.lo) ? v : l.lo;
+    v = (v < l.hi) ? v : l.hi;
+    return v;
+}
+
+// Any format, a sample per iteration
+static void convertScalar(const int32_t *in, uint8_t *out, size_t samples, int format, const PcmLimits &l)
+{
+    const int bits = SDL_AUDIO_BITSIZE(format);
+    const bool is_float = SDL_AUDIO_ISFLOAT(format) != 0;
+    const bool swap = (SDL_AUDIO_ISBIGENDIAN(format) != 0) != (SDL_BYTEORDER == SDL_BIG_ENDIAN);
+    const uint32_t flip = SDL_AUDIO_ISSIGNED(format) ? 0 : (1u << (bits - 1));
+
+    for(size_t i = 0; i < samples; ++i)
+    {
+        float v = clipSample(in[i], l);
+
+        switch(bits)
+        {
+        case 8:
+            out[i] = static_cast<uint8_t>(static_cast<uint32_t>(static_cast<int32_t>(v)) ^ flip);
+            break;
+
+        case 16:
+        {
+            uint16_t s = static_cast<uint16_t>(static_cast<uint32_t>(static_cast<int32_t>(v)) ^ flip);
+            if(swap)
+                s = swap16(s);
+            std::memcpy(out + i * 2, &s, 2);
+            break;
+        }
+
+        case 32:
+        {
+            uint32_t s;
+            if(is_float)
+                std::memcpy(&s, &v, 4);
+            else
+                s = static_cast<uint32_t>(static_cast<int32_t>(v));
+            if(swap)
+                s = swap32(s);
+            std::memcpy(out + i * 4, &s, 4);
+            break;
+        }
+        }
+    }
+}
+
+#if defined(PCM_CONVERT_SSE2)
+// Native byte order formats, eight samples per iteration
+static size_t convertVector(const int32_t *in, uint8_t *out, size_t samples, int format, const PcmLimits &l)
+{
+    const __m128 scale = _mm_set1_ps(l.scale);
+    const __m128 lo = _mm_set1_ps(l.lo);
+    const __m128 hi = _mm_set1_ps(l.hi);
+    const int bits = SDL_AUDIO_BITSIZE(format);
+    const bool is_float = SDL_AUDIO_ISFLOAT(format) != 0;
+    const __m128i flip8 = _mm_set1_epi8(SDL_AUDIO_ISSIGNED(format) ? 0 : -128);
+    const __m128i flip16 = _mm_set1_epi16(SDL_AUDIO_ISSIGNED(format) ? 0 : -32768);
+    size_t i = 0;
+
+    for(; i + 8 <= samples; i += 8)
+    {
+        __m128 a = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+        __m128 b = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 4)));
+        a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(a, scale), lo), hi);
+        b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(b, scale), lo), hi);
+
+        if(is_float)
+        {
+            _mm_storeu_ps(reinterpret_cast<float *>(out) + i, a);
+            _mm_storeu_ps(reinterpret_cast<float *>(out) + i + 4, b);
+            continue;
+        }
+
+        __m128i ia = _mm_cvttps_epi32(a);
+        __m128i ib = _mm_cvttps_epi32(b);
+
+        switch(bits)
+        {
+        case 8:
+        {
+            __m128i s = _mm_packs_epi16(_mm_packs_epi32(ia, ib), _mm_setzero_si128());
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_xor_si128(s, flip8));
+            break;
+        }
+        case 16:
+        {
+            __m128i s = _mm_packs_epi32(ia, ib);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2), _mm_xor_si128(s, flip16));
+            break;
+        }
+        case 32:
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 4), ia);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 4 + 16), ib);
+            break;
+        }
+    }
+
+    return i;
+}
+#elif defined(PCM_CONVERT_NEON)
+// Native byte order formats, eight samples per iteration
+static size_t convertVector(const int32_t *in, uint8_t *out, size_t samples, int format, const PcmLimits &l)
+{
+    const float32x4_t scale = vdupq_n_f32(l.scale);
+    const float32x4_t lo = vdupq_n_f32(l.lo);
+    const float32x4_t hi = vdupq_n_f32(l.hi);
+    const int bits = SDL_AUDIO_BITSIZE(format);
+    const bool is_float = SDL_AUDIO_ISFLOAT(format) != 0;
+    const uint8x8_t flip8 = vdup_n_u8(SDL_AUDIO_ISSIGNED(format) ? 0 : 0x80);
+    const uint16x8_t flip16 = vdupq_n_u16(SDL_AUDIO_ISSIGNED(format) ? 0 : 0x8000);
+    size_t i = 0;
+
+    for(; i + 8 <= samples; i += 8)
+    {
+        float32x4_t a = vcvtq_f32_s32(vld1q_s32(in + i));
+        float32x4_t b = vcvtq_f32_s32(vld1q_s32(in + i + 4));
+        a = vminq_f32(vmaxq_f32(vmulq_f32(a, scale), lo), hi);
+        b = vminq_f32(vmaxq_f32(vmulq_f32(b, scale), lo), hi);
+
+        if(is_float)
+        {
+            vst1q_f32(reinterpret_cast<float *>(out) + i, a);
+            vst1q_f32(reinterpret_cast<float *>(out) + i + 4, b);
+            continue;
+        }
+
+        int32x4_t ia = vcvtq_s32_f32(a);
+        int32x4_t ib = vcvtq_s32_f32(b);
+
+        switch(bits)
+        {
+        case 8:
+        {
+            int8x8_t s = vqmovn_s16(vcombine_s16(vqmovn_s32(ia), vqmovn_s32(ib)));
+            vst1_u8(out + i, veor_u8(vreinterpret_u8_s8(s), flip8));
+            break;
+        }
+        case 16:
+        {
+            int16x8_t s = vcombine_s16(vqmovn_s32(ia), vqmovn_s32(ib));
+            vst1q_u16(reinterpret_cast<uint16_t *>(out + i * 2), veorq_u16(vreinterpretq_u16_s16(s), flip16));
+            break;
+        }
+        case 32:
+            vst1q_s32(reinterpret_cast<int32_t *>(out + i * 4), ia);
+            vst1q_s32(reinterpret_cast<int32_t *>(out + i * 4 + 16), ib);
+            break;
+        }
+    }
+
+    return i;
+}
+#endif
+
+void pcmGainConvert(const int32_t *in, void *out, size_t samples, int format, float gain)
+{
+    const PcmLimits l = pcmLimits(format, gain);
+    uint8_t *dst = reinterpret_cast<uint8_t *>(out);
+    size_t done = 0;
+
+#if defined(PCM_CONVERT_SSE2) || defined(PCM_CONVERT_NEON)
+    if(SDL_AUDIO_BITSIZE(format) == 8 ||
+       (SDL_AUDIO_ISBIGENDIAN(format) != 0) == (SDL_BYTEORDER == SDL_BIG_ENDIAN))
+        done = convertVector(in, dst, samples, format, l);
+#endif
+
+    convertScalar(in + done, dst + done * pcmSampleSize(format), samples - done, format, l);
+}
+
+void pcmGainClipFloat(float *buffer, size_t samples, float gain)
+{
+    size_t i = 0;
+
+#if defined(PCM_CONVERT_SSE2)
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    for(; i + 4 <= samples; i += 4)
+    {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(buffer + i), g);
+        _mm_storeu_ps(buffer + i, _mm_min_ps(_mm_max_ps(v, lo), hi));
+    }
+#elif defined(PCM_CONVERT_NEON)
+    const float32x4_t g = vdupq_n_f32(gain);
+    const float32x4_t lo = vdupq_n_f32(-1.0f);
+    const float32x4_t hi = vdupq_n_f32(1.0f);
+    for(; i + 4 <= samples; i += 4)
+    {
+        float32x4_t v = vmulq_f32(vld1q_f32(buffer + i), g);
+        vst1q_f32(buffer + i, vminq_f32(vmaxq_f32(v, lo), hi));
+    }
+#endif
+
+    for(; i < samples; ++i)
+    {
+        float v = buffer[i] * gain;
+        v = (v > -1.0f) ? v : -1.0f;
+        v = (v < 1.0f) ? v : 1.0f;
+        buffer[i] = v;
+    }
+}
+
+size_t pcmSampleSize(int format)
+{
+    return SDL_AUDIO_BITSIZE(format) / 8;
+}
@@ -0,0 +1,46 @@
+//
+// Copyright(C) 2025-2026 Vitaliy Novichkov
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef PCM_CONVERT_H
+#define PCM_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Apply the gain, clip and convert the synth's samples into the output format in one pass
+ * @param in Input samples, the full scale is the range of 32-bit integer
+ * @param out Output buffer, may be the same memory as input when the output samples are 32-bit
+ * @param samples Count of samples (not frames!)
+ * @param format Output format, any of SDL's AUDIO_* formats
+ * @param gain Amplitude factor
+ */
+extern void pcmGainConvert(const int32_t *in, void *out, size_t samples, int format, float gain);
+
+/**
+ * @brief Apply the gain and clip the normalized float samples in place
+ * @param buffer Samples to process
+ * @param samples Count of samples (not frames!)
+ * @param gain Amplitude factor
+ */
+extern void pcmGainClipFloat(float *buffer, size_t samples, float gain);
+
+/**
+ * @brief Size of one sample of the output format in bytes
+ * @param format Output format, any of SDL's AUDIO_* formats
+ * @return Size of one sample
+ */
+extern size_t pcmSampleSize(int format);
+
+#endif // PCM_CONVERT_H
@@ -28,57 +28,66 @@
 
 #include "../midi_sequencer.hpp"
 
-void BW_MidiSequencer::insertDataToBank(BW_MidiSequencer::MidiEvent &evt, U8List &bank, const uint8_t *data, size_t length)
+void BW_MidiSequencer::attachDataBlock(BW_MidiSequencer::MidiEvent &evt, size_t offset)
 {
-    evt.data_block.offset = bank.size;
-    bank.push_back_list(data, length);
-    evt.data_block.size = bank.size - evt.data_block.offset;
+    DataBlock block;
+    block.offset = offset;
+    block.size = m_dataBank.size - offset;
+    evt.data_block = static_cast<uint32_t>(m_dataBlocks.size);
+    m_dataBlocks.push_back(block);
 }
 
-void BW_MidiSequencer::insertDataToBank(BW_MidiSequencer::MidiEvent &evt, U8List &bank, FileAndMemReader &fr, size_t length)
+void BW_MidiSequencer::insertDataToBank(BW_MidiSequencer::MidiEvent &evt, const uint8_t *data, size_t length)
 {
-    evt.data_block.offset = bank.size;
-    bank.resize(bank.size + length);
-    fr.read(bank.data + evt.data_block.offset, 1, length);
-    evt.data_block.size = bank.size - evt.data_block.offset;
+    size_t offset = m_dataBank.size;
+    m_dataBank.push_back_list(data, length);
+    attachDataBlock(evt, offset);
 }
 
-void BW_MidiSequencer::insertDataToBankWithByte(BW_MidiSequencer::MidiEvent &evt, U8List &bank, uint8_t begin_byte, const uint8_t *data, size_t length)
+void BW_MidiSequencer::insertDataToBank(BW_MidiSequencer::MidiEvent &evt, FileAndMemReader &fr, size_t length)
 {
-    evt.data_block.offset = bank.size;
-    bank.push_back(begin_byte);
-    bank.push_back_list(data, length);
-    evt.data_block.size = bank.size - evt.data_block.offset;
+    size_t offset = m_dataBank.size;
+    m_dataBank.resize(m_dataBank.size + length);
+    fr.read(m_dataBank.data + offset, 1, length);
+    attachDataBlock(evt, offset);
 }
 
-void BW_MidiSequencer::insertDataToBankWithByte(BW_MidiSequencer::MidiEvent &evt, U8List &bank, uint8_t begin_byte, FileAndMemReader &fr, size_t length)
+void BW_MidiSequencer::insertDataToBankWithByte(BW_MidiSequencer::MidiEvent &evt, uint8_t begin_byte, const uint8_t *data, size_t length)
 {
-    evt.data_block.offset = bank.size;
-    bank.push_back(begin_byte);
-    bank.resize(bank.size + length);
-    fr.read(bank.data + evt.data_block.offset + 1, 1, length);
-    evt.data_block.size = bank.size - evt.data_block.offset;
+    size_t offset = m_dataBank.size;
+    m_dataBank.push_back(begin_byte);
+    m_dataBank.push_back_list(data, length);
+    attachDataBlock(evt, offset);
 }
 
-void BW_MidiSequencer::insertDataToBankWithTerm(BW_MidiSequencer::MidiEvent &evt, U8List &bank, const uint8_t *data, size_t length)
+void BW_MidiSequencer::insertDataToBankWithByte(BW_MidiSequencer::MidiEvent &evt, uint8_t begin_byte, FileAndMemReader &fr, size_t length)
+{
+    size_t offset = m_dataBank.size;
+    m_dataBank.push_back(begin_byte);
+    m_dataBank.resize(m_dataBank.size + length);
+    fr.read(m_dataBank.data + offset + 1, 1, length);
+    attachDataBlock(evt, offset);
+}
+
+void BW_MidiSequencer::insertDataToBankWithTerm(BW_MidiSequencer::MidiEvent &evt, const uint8_t *data, size_t length)
 {
     const uint8_t null[] = {0, 0};
-    evt.data_block.offset = bank.size;
-    bank.push_back_list(data, length);
-    bank.push_back_list(null, 2); /* Second terminator is an ending fix for UTF16 strings */
-    evt.data_block.size = bank.size - evt.data_block.offset;
+    size_t offset = m_dataBank.size;
+    m_dataBank.push_back_list(data, length);
+    m_dataBank.push_back_list(null, 2); /* Second terminator is an ending fix for UTF16 strings */
+    attachDataBlock(evt, offset);
 }
 
-void BW_MidiSequencer::insertDataToBankWithTerm(BW_MidiSequencer::MidiEvent &evt, U8List &bank, FileAndMemReader &fr, size_t length)
+void BW_MidiSequencer::insertDataToBankWithTerm(BW_MidiSequencer::MidiEvent &evt, FileAndMemReader &fr, size_t length)
 {
-    size_t tail = bank.size + length;
-    evt.data_block.offset = bank.size;
-    bank.resize(bank.size + length + 2);
-    fr.read(bank.data + evt.data_block.offset, 1, length);
+    size_t offset = m_dataBank.size;
+    size_t tail = offset + length;
+    m_dataBank.resize(m_dataBank.size + length + 2);
+    fr.read(m_dataBank.data + offset, 1, length);
     /* Second terminator is an ending fix for UTF16 strings */
-    bank.data[tail] = 0;
-    bank.data[tail + 1] = 0;
-    evt.data_block.size = bank.size - evt.data_block.offset;
+    m_dataBank.data[tail] = 0;
+    m_dataBank.data[tail + 1] = 0;
+    attachDataBlock(evt, offset);
 }
 
 void BW_MidiSequencer::addEventToBank(BW_MidiSequencer::MidiTrackRow &row, const MidiEvent &evt)
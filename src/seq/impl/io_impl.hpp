@@ -122,10 +122,15 @@ double BW_MidiSequencer::seek(double seconds, const double granularity)
     // Turn loop pooints off because it causes wrong position rememberin on a quick seek
     m_loopEnabled = false;
 
+    // Remember the song state on every checkpoint for this and next seeks
+    if(m_seekIndexState == SEEK_INDEX_NONE)
+        seekIndexBuild();
+
     /*
      * Seeking search is similar to regular ticking, except of next things:
      * - We don't processsing arpeggio and vibrato
      * - To keep correctness of the state after seek, begin every search from begin
+     *   or from the nearest checkpoint of the seek index
      * - All sustaining notes must be killed
      * - Ignore Note-On events
      */
@@ -141,6 +146,10 @@ double BW_MidiSequencer::seek(double seconds, const double granularity)
 
     m_loop.temporaryBroken = (seconds >= m_loopEndTime);
 
+    // Start from the nearest checkpoint instead of the song begin
+    if(m_seekIndexState == SEEK_INDEX_READY && m_currentPosition.absTimePosition < seconds)
+        seekIndexRestore(seconds + granualityHalf);
+
     while((m_currentPosition.absTimePosition < seconds) &&
           (m_currentPosition.absTimePosition < m_fullSongTimeLength))
     {
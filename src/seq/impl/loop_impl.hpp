@@ -177,19 +177,19 @@ void BW_MidiSequencer::installLoop(BW_MidiSequencer::LoopPointParseState &loopSt
         for(size_t tk = 0; tk < m_tracksCount; ++tk)
         {
             Position::TrackInfo &track = scanPosition.track[tk];
-            MidiTrackRow *ti = NULL;
-            // MidiTrackQueue::Leaf_t *end = m_trackData[tk].m_end;
+            const MidiTrackQueue &trackData = m_trackData[tk];
+            const MidiTrackRow *ti = NULL;
 
             if((track.lastHandledEvent >= 0) && (track.delay <= 0))
             {
                 // Check is an end of track has been reached
-                if(track.pos == NULL)
+                if(track.pos >= trackData.size)
                 {
                     track.lastHandledEvent = -1;
                     break;
                 }
 
-                ti = &track.pos->data;
+                ti = &trackData[track.pos];
 
                 for(size_t i = ti->events_begin; i < ti->events_end; ++i)
                 {
@@ -291,7 +291,7 @@ void BW_MidiSequencer::installLoop(BW_MidiSequencer::LoopPointParseState &loopSt
                 if(track.lastHandledEvent >= 0)
                 {
                     track.delay += ti->delay;
-                    track.pos = track.pos->next;
+                    ++track.pos;
                 }
             }
         }
@@ -49,6 +49,8 @@
 
 void BW_MidiSequencer::buildSmfSetupReset(size_t trackCount)
 {
+    DataBlock emptyBlock;
+
     m_stateRestoreSetup = TRACK_RESTORE_DEFAULT;
     m_tracksCount = trackCount;
     m_fullSongTimeLength = 0.0;
@@ -68,11 +70,20 @@ void BW_MidiSequencer::buildSmfSetupReset(size_t trackCount)
     m_musTrackTitles.clear();
     m_musMarkers.clear();
     m_dataBank.clear();
+    m_dataBlocks.clear();
     m_eventBank.clear();
     m_branches.clear();
 
     m_trackData.clear();
     m_trackState.clear();
+    seekIndexClear();
+
+    // Everything of the previous song is cleared, reuse its memory
+    m_songArena.reset();
+
+    // Events having no data block refer the first entry
+    std::memset(&emptyBlock, 0, sizeof(DataBlock));
+    m_dataBlocks.push_back(emptyBlock);
 
     m_loop.reset();
     m_loop.invalidLoop = false;
@@ -85,8 +96,13 @@ void BW_MidiSequencer::buildSmfSetupReset(size_t trackCount)
 
 void BW_MidiSequencer::buildSmfResizeTracks(size_t tracksCount)
 {
+    size_t oldCount = m_trackData.size;
+
     m_tracksCount = tracksCount;
     m_trackData.resize(m_tracksCount);
+
+    for(size_t tk = oldCount; tk < m_tracksCount; ++tk)
+        m_trackData[tk].set_arena(&m_songArena);
     m_trackState.resize(m_tracksCount);
     m_trackBeginPosition.tracks_resize(m_tracksCount);
 }
@@ -94,18 +110,17 @@ void BW_MidiSequencer::buildSmfResizeTracks(size_t tracksCount)
 
 void BW_MidiSequencer::initTracksBegin(size_t track)
 {
-    if(m_trackData[track].size() > 0)
+    if(!m_trackData[track].empty())
     {
-        MidiTrackQueue::Leaf_t *pos = m_trackData[track].m_begin;
-        m_trackBeginPosition.track[track].pos = pos;
+        m_trackBeginPosition.track[track].pos = 0;
         // Some events doesn't begin at zero!
-        m_trackBeginPosition.track[track].delay = pos->data.absPos;
+        m_trackBeginPosition.track[track].delay = m_trackData[track][0].absPos;
         m_trackBeginPosition.track[track].lastHandledEvent = 0;
         std::memcpy(&m_trackBeginPosition.track[track].state, &m_trackState[track].state, sizeof(TrackStateSaved));
     }
     else
     {
-        m_trackBeginPosition.track[track].pos = NULL;
+        m_trackBeginPosition.track[track].pos = 0;
         m_trackBeginPosition.track[track].delay = 0;
         m_trackBeginPosition.track[track].lastHandledEvent = -1;
     }
@@ -133,6 +148,14 @@ void BW_MidiSequencer::buildTimeLine(const TemposList &tempos,
 
     std::memset(&fakePos, 0, sizeof(MidiTrackRow));
 
+    // Loading is done at this point, give back the spare capacity
+    m_eventBank.shrink_to_fit();
+    m_dataBank.shrink_to_fit();
+    m_dataBlocks.shrink_to_fit();
+
+    for(tk = 0; tk < m_tracksCount; ++tk)
+        m_trackData[tk].shrink_to_fit();
+
     points.reserve(100);
 
 
@@ -156,7 +179,7 @@ void BW_MidiSequencer::buildTimeLine(const TemposList &tempos,
         std::fflush(stdout);
 #endif
 
-        posPrev = &track.m_begin->data;//First element
+        posPrev = &track[0];//First element
 
         // If doesn't begins with zero, add a fake one!
         if(posPrev->absPos > 0)
@@ -166,12 +189,12 @@ void BW_MidiSequencer::buildTimeLine(const TemposList &tempos,
             posPrev = &fakePos;
         }
 
-        for(MidiTrackQueue::Leaf_t *it = track.m_begin; it != NULL; it = it->next)
+        for(MidiTrackRow *it = track.begin(); it != track.end(); ++it)
         {
 #ifdef BWMIDI_DEBUG_TIME_CALCULATION
             bool tempoChanged = false;
 #endif
-            MidiTrackRow &pos = it->data;
+            MidiTrackRow &pos = *it;
             if((posPrev != &pos) && // Skip first event
                (!tempos.empty()) && // Only when in-track tempo events are available
                (tempo_change_index < tempos.size)
@@ -244,7 +267,7 @@ void BW_MidiSequencer::buildTimeLine(const TemposList &tempos,
                 MidiEvent &e = m_eventBank[i];
                 if((e.type == MidiEvent::T_SPECIAL) && (e.subtype == MidiEvent::ST_MARKER))
                 {
-                    marker.label = e.data_block;
+                    marker.label = getBlock(e);
                     marker.pos_ticks = pos.absPos;
                     marker.pos_time = pos.time;
                     m_musMarkers.push_back(marker);
@@ -306,13 +329,15 @@ void BW_MidiSequencer::buildTimeLine(const TemposList &tempos,
                 if((track.lastHandledEvent >= 0) && (track.delay <= 0))
                 {
                     // Check is an end of track has been reached
-                    if(track.pos == NULL)
+                    if(track.pos >= m_trackData[tk].size)
                     {
                         track.lastHandledEvent = -1;
                         continue;
                     }
 
-                    for(i = track.pos->data.events_begin; i < track.pos->data.events_end; ++i)
+                    const MidiTrackRow &row = m_trackData[tk][track.pos];
+
+                    for(i = row.events_begin; i < row.events_end; ++i)
                     {
                         const MidiEvent &evt = m_eventBank[i];
                         if(evt.type == MidiEvent::T_SPECIAL && evt.subtype == MidiEvent::ST_LOOPSTART)
@@ -325,8 +350,8 @@ void BW_MidiSequencer::buildTimeLine(const TemposList &tempos,
 
                     if(track.lastHandledEvent >= 0)
                     {
-                        track.delay += track.pos->data.delay;
-                        track.pos = track.pos->next;
+                        track.delay += row.delay;
+                        ++track.pos;
                     }
                 }
             }
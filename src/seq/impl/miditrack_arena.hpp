@@ -0,0 +1,193 @@
+/*
+ * BW_Midi_Sequencer - MIDI Sequencer for C++
+ *
+ * Copyright (c) 2015-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#if !defined(BW_MIDISEQ_MIDITRACK_ARENA_HPP)
+#define BW_MIDISEQ_MIDITRACK_ARENA_HPP
+
+#include <stddef.h>
+#include <cstdlib>
+#if defined(__DJGPP__)
+#include "dpmi_alloc.hpp"
+#endif
+
+/**
+ * @brief Bump allocator for the data living as long as the loaded song
+ *
+ * Blocks are taken from the end of the current chunk and never freed one by
+ * one: everything gets released at once by reset(). The last taken block can
+ * be grown or shrunk in place. The largest chunk is kept on reset to serve the
+ * next song without going to the system allocator again.
+ */
+struct miditrack_arena
+{
+    struct Chunk
+    {
+        Chunk *next;
+        size_t size;
+        size_t used;
+    };
+
+    enum
+    {
+        //! Alignment of every block
+        ALIGN = 16,
+        //! Size of the header placed at the beginning of every chunk
+        HEADER_SIZE = (sizeof(Chunk) + ALIGN - 1) & ~(size_t)(ALIGN - 1),
+        //! Minimal size of the chunk
+        CHUNK_SIZE = 64 * 1024
+    };
+
+    //! Current chunk, followed by older ones
+    Chunk *head;
+    //! The last taken block
+    void *last;
+
+    miditrack_arena() :
+        head(NULL),
+        last(NULL)
+    {}
+
+    ~miditrack_arena()
+    {
+        release();
+    }
+
+    static size_t blockSize(size_t bytes)
+    {
+        // Empty blocks take space too, so no two blocks share the address
+        if(bytes == 0)
+            bytes = 1;
+
+        return (bytes + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+    }
+
+    static unsigned char *chunkData(Chunk *c)
+    {
+        return reinterpret_cast<unsigned char*>(c) + HEADER_SIZE;
+    }
+
+    void *allocate(size_t bytes)
+    {
+        bytes = blockSize(bytes);
+
+        if(!head || head->size - head->used < bytes)
+        {
+            // Every new chunk is at least twice larger than previous
+            size_t size = head ? head->size * 2 : (size_t)CHUNK_SIZE;
+
+            if(size < bytes)
+                size = bytes;
+
+            Chunk *c = (Chunk*)std::malloc(HEADER_SIZE + size);
+            if(!c)
+                return NULL;
+
+#ifdef ENABLE_HW_OPL_DOS
+            dpmi_allocator_impl::dpmi_lock_memory(c, HEADER_SIZE + size);
+#endif
+            c->next = head;
+            c->size = size;
+            c->used = 0;
+            head = c;
+        }
+
+        last = chunkData(head) + head->used;
+        head->used += bytes;
+
+        return last;
+    }
+
+    /**
+     * @brief Change the size of the last taken block in place
+     * @param ptr Block to resize
+     * @param old_bytes Current size of the block
+     * @param new_bytes New size of the block
+     * @return true if resized, false if the block is not the last one or doesn't fit
+     */
+    bool resize_last(void *ptr, size_t old_bytes, size_t new_bytes)
+    {
+        size_t base;
+
+        if(!ptr || ptr != last)
+            return false;
+
+        base = head->used - blockSize(old_bytes);
+        new_bytes = blockSize(new_bytes);
+
+        if(head->size - base < new_bytes)
+            return false;
+
+        head->used = base + new_bytes;
+        return true;
+    }
+
+    /**
+     * @brief Release all taken blocks, keeping the largest chunk for reuse
+     */
+    void reset()
+    {
+        if(!head)
+            return;
+
+        Chunk *c = head->next;
+
+        while(c)
+        {
+            Chunk *next = c->next;
+            freeChunk(c);
+            c = next;
+        }
+
+        head->next = NULL;
+        head->used = 0;
+        last = NULL;
+    }
+
+    /**
+     * @brief Give all memory back to the system
+     */
+    void release()
+    {
+        while(head)
+        {
+            Chunk *next = head->next;
+            freeChunk(head);
+            head = next;
+        }
+
+        last = NULL;
+    }
+
+private:
+    static void freeChunk(Chunk *c)
+    {
+#ifdef ENABLE_HW_OPL_DOS
+        dpmi_allocator_impl::dpmi_unlock_memory(c, HEADER_SIZE + c->size);
+#endif
+        std::free(c);
+    }
+};
+
+#endif /* BW_MIDISEQ_MIDITRACK_ARENA_HPP */
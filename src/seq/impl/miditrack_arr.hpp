@@ -28,9 +28,16 @@
 
 #include <stddef.h>
 #include <cstdlib>
+#include <cstring>
+#include <new>
+#if __cplusplus >= 201103L
+#   include <utility>
+#   define BWMIDI_ARR_HAS_MOVE
+#endif
 #if defined(__DJGPP__)
 #include "dpmi_alloc.hpp"
 #endif
+#include "miditrack_arena.hpp"
 
 template<class T, bool is_class=false>
 struct miditrack_arr
@@ -42,18 +49,45 @@ struct miditrack_arr
     T *data;
     size_t size;
     size_t capacity;
+    //! Arena to take the storage from, or NULL to use the heap
+    miditrack_arena *arena;
 
     miditrack_arr() :
         data(NULL),
         size(0),
-        capacity(0)
+        capacity(0),
+        arena(NULL)
     {}
 
+#ifdef BWMIDI_ARR_HAS_MOVE
+    miditrack_arr(miditrack_arr &&o) :
+        data(o.data),
+        size(o.size),
+        capacity(o.capacity),
+        arena(o.arena)
+    {
+        o.data = NULL;
+        o.size = 0;
+        o.capacity = 0;
+    }
+#endif
+
+    /**
+     * @brief Take the storage from the arena from now, the array gets cleared
+     * @param a Arena, or NULL to use the heap
+     */
+    void set_arena(miditrack_arena *a)
+    {
+        clear();
+        arena = a;
+    }
+
     void move_to(miditrack_arr<T> &dst)
     {
         dst.data = data;
         dst.size = size;
         dst.capacity = capacity;
+        dst.arena = arena;
 
         data = NULL;
         size = 0;
@@ -107,42 +141,87 @@ struct miditrack_arr
         return size == 0;
     }
 
-    void reserve_extend(size_t count)
+    /**
+     * @brief Move elements into the storage of the new capacity
+     * @param new_capacity New capacity, not less than the size
+     */
+    void relocate(size_t new_capacity)
     {
-        if(capacity == 0)
+        T *old_data = data;
+
+        if(arena)
         {
-            data = (T*)std::malloc(count * sizeof(T));
-            capacity = count;
+            if(arena->resize_last(data, capacity * sizeof(T), new_capacity * sizeof(T)))
+            {
+                capacity = new_capacity;
+                return;
+            }
+
+            if(new_capacity < capacity)
+                return; // Blocks in the middle of the arena can't shrink
+
+            // The old block stays in the arena until it gets reset
+            data = (T*)arena->allocate(new_capacity * sizeof(T));
         }
         else
         {
 #ifdef ENABLE_HW_OPL_DOS
-            dpmi_allocator_impl::dpmi_unlock_memory(data, capacity * sizeof(T));
+            if(data)
+                dpmi_allocator_impl::dpmi_unlock_memory(data, capacity * sizeof(T));
 #endif
-            // if(is_class)
-            // {
-            T *old_data = data;
-            data = (T*)std::malloc((capacity + count) * sizeof(T));
 
-            // Copy old data
-            for(size_t i = 0; i < size; ++i)
-                new (data + i) T(old_data[i]);
+            if(!is_class)
+            {
+                // Plain data gets moved by the allocator, often without copying at all
+                data = (T*)std::realloc((void*)data, new_capacity * sizeof(T));
+                old_data = NULL;
+            }
+            else
+                data = (T*)std::malloc(new_capacity * sizeof(T));
+
+#ifdef ENABLE_HW_OPL_DOS
+            dpmi_allocator_impl::dpmi_lock_memory(data, new_capacity * sizeof(T));
+#endif
+        }
 
-            // Delete old data
+        if(old_data && is_class)
+        {
             for(size_t i = 0; i < size; ++i)
+            {
+#ifdef BWMIDI_ARR_HAS_MOVE
+                new (data + i) T(std::move(old_data[i]));
+#else
+                new (data + i) T(old_data[i]);
+#endif
                 old_data[i].~T();
+            }
+        }
+        else if(old_data)
+            std::memcpy((void*)data, (const void*)old_data, size * sizeof(T));
 
+        if(old_data && !arena)
             std::free(old_data);
-            // }
-            // else
-            //     data = (T*)std::realloc(data, (capacity + count) * sizeof(T));
 
-            capacity += count;
-        }
+        capacity = new_capacity;
+    }
 
-#ifdef ENABLE_HW_OPL_DOS
-        dpmi_allocator_impl::dpmi_lock_memory(data, capacity * sizeof(T));
-#endif
+    /**
+     * @brief Grow the capacity geometrically to fit the given count of elements
+     * @param count Count of elements to fit
+     */
+    void grow(size_t count)
+    {
+        size_t new_capacity = capacity > 0 ? capacity * 2 : 16;
+
+        if(new_capacity < count)
+            new_capacity = count;
+
+        relocate(new_capacity);
+    }
+
+    void reserve_extend(size_t count)
+    {
+        relocate(capacity + count);
     }
 
     void reserve(size_t count)
@@ -150,13 +229,27 @@ struct miditrack_arr
         if(count <= capacity)
             return;
 
-        reserve_extend(count - capacity);
+        relocate(count);
+    }
+
+    /**
+     * @brief Release the capacity not used by elements
+     */
+    void shrink_to_fit()
+    {
+        if(size == capacity)
+            return;
+
+        if(size == 0)
+            clear();
+        else
+            relocate(size);
     }
 
     void push_back(const T &value)
     {
-        if(size + 1 >= capacity)
-            reserve_extend(4096);
+        if(size >= capacity)
+            grow(size + 1);
 
         if(is_class)
             new (data + size) T(value);
@@ -168,8 +261,8 @@ struct miditrack_arr
 
     void push_back_list(const T*in_data, size_t count)
     {
-        if(size + count >= capacity)
-            reserve_extend(count + 1024);
+        if(size + count > capacity)
+            grow(size + count);
 
         for(size_t i = 0; i < count; ++i)
         {
@@ -191,13 +284,8 @@ struct miditrack_arr
         if(data)
             clear();
 
-        data = (T*)std::malloc(count * sizeof(T));
-        capacity = size = count;
-
-
-#ifdef ENABLE_HW_OPL_DOS
-        dpmi_allocator_impl::dpmi_lock_memory(data, count * sizeof(T));
-#endif
+        relocate(count);
+        size = count;
 
         for(size_t i = 0; i < size; ++i)
         {
@@ -213,11 +301,8 @@ struct miditrack_arr
         if(data)
             clear();
 
-        data = (T*)std::malloc(count * sizeof(T));
-        capacity = size = count;
-#ifdef ENABLE_HW_OPL_DOS
-        dpmi_allocator_impl::dpmi_lock_memory(data, count * sizeof(T));
-#endif
+        relocate(count);
+        size = count;
 
         if(is_class)
         {
@@ -232,11 +317,9 @@ struct miditrack_arr
             clear();
         else if(!data)
         {
-            data = (T*)std::malloc(count * sizeof(T));
-            capacity = size = count;
-#ifdef ENABLE_HW_OPL_DOS
-            dpmi_allocator_impl::dpmi_lock_memory(data, count * sizeof(T));
-#endif
+            relocate(count);
+            size = count;
+
             if(is_class)
             {
                 for(size_t i = 0; i < size; ++i)
@@ -261,56 +344,17 @@ struct miditrack_arr
 
     void expand(size_t count)
     {
-        T *old_data = data;
-
         if(size > count)
             return; // Nothing to expand!
 
-        if(size + count <= capacity)
-        {
-            // If we fit in capacity
-            // Just initialize new data
-            for(size_t i = size; i < count; ++i)
-                new (data + i) T();
+        if(count > capacity)
+            grow(count);
 
-            size = count;
+        // Initialize new data
+        for(size_t i = size; i < count; ++i)
+            new (data + i) T();
 
-            return;
-        }
-
-        data = (T*)std::malloc(count * sizeof(T));
-
-#ifdef ENABLE_HW_OPL_DOS
-        dpmi_allocator_impl::dpmi_lock_memory(data, count * sizeof(T));
-#endif
-
-        if(is_class)
-        {
-            // Copy old data
-            for(size_t i = 0; i < size; ++i)
-                new (data + i) T(old_data[i]);
-
-            // Initialize new data
-            for(size_t i = size; i < count; ++i)
-                new (data + i) T();
-
-            // Delete old data
-            for(size_t i = 0; i < size; ++i)
-                old_data[i].~T();
-        }
-        else
-        {
-            // Copy old data
-            for(size_t i = 0; i < size; ++i)
-                data[i] = old_data[i];
-        }
-
-#ifdef ENABLE_HW_OPL_DOS
-        dpmi_allocator_impl::dpmi_unlock_memory(old_data, size * sizeof(T));
-#endif
-        std::free(old_data);
-
-        capacity = size = count;
+        size = count;
     }
 
     void clear()
@@ -323,10 +367,13 @@ struct miditrack_arr
                     data[i].~T();
             }
 
+            if(!arena)
+            {
 #ifdef ENABLE_HW_OPL_DOS
-            dpmi_allocator_impl::dpmi_unlock_memory(data, size * sizeof(T));
+                dpmi_allocator_impl::dpmi_unlock_memory(data, capacity * sizeof(T));
 #endif
-            std::free(data);
+                std::free(data);
+            }
         }
 
         data = NULL;
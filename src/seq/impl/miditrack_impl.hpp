@@ -73,6 +73,7 @@ void BW_MidiSequencer::Position::tracks_reset()
 
 void BW_MidiSequencer::Position::tracks_init_one(TrackInfo &t)
 {
+    t.pos = 0;
     t.delay = 0;
     t.lastHandledEvent = 0;
     std::memset(&t.state, 0, sizeof(t.state));
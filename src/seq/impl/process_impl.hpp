@@ -65,11 +65,12 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
     if(m_interface->onEvent && evt.type < 0x100 && evt.subtype < 0x100)
     {
         // Only standard MIDI events will be reported, built-in events (>=0x100) will remain private
+        const DataBlock &block = getBlock(evt);
 
-        if(evt.data_block.size > 0)
+        if(block.size > 0)
             m_interface->onEvent(m_interface->onEvent_userData,
                                  evt.type, evt.subtype, evt.channel,
-                                 getData(evt.data_block), evt.data_block.size);
+                                 getData(block), block.size);
         else
             m_interface->onEvent(m_interface->onEvent_userData,
                                  evt.type, evt.subtype, evt.channel,
@@ -92,23 +93,33 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
     if(tk.state.track_channel != midCh)
         tk.state.track_channel = midCh; // Remember track's current channel if changed
 
+    // Keep the order of batched channel events relatively to other hooks
+    if(m_rtBatchCount > 0 &&
+       (evt.type == MidiEvent::T_SYSEX || evt.type == MidiEvent::T_SYSEX2 || evt.type == MidiEvent::T_SPECIAL))
+        rtBatchFlush();
+
     switch(evt.type)
     {
     case MidiEvent::T_SYSEX:
     case MidiEvent::T_SYSEX2: // Handle SysEx
         if(m_interface->rt_systemExclusive)
-            m_interface->rt_systemExclusive(m_interface->rtUserData, getData(evt.data_block), evt.data_block.size);
+        {
+            const DataBlock &block = getBlock(evt);
+            m_interface->rt_systemExclusive(m_interface->rtUserData, getData(block), block.size);
+        }
         return;
 
     case MidiEvent::T_SPECIAL:
     {
         if(m_interface->rt_metaEvent && evt.subtype < 0x100) // Meta event hook
         {
+            const DataBlock &block = getBlock(evt);
+
             if(evt.data_loc_size > 0)
                 m_interface->rt_metaEvent(m_interface->rtUserData, evt.subtype, evt.data_loc, evt.data_loc_size);
 
-            if(evt.data_block.size > 0)
-                m_interface->rt_metaEvent(m_interface->rtUserData, evt.subtype, getData(evt.data_block), evt.data_block.size);
+            if(block.size > 0)
+                m_interface->rt_metaEvent(m_interface->rtUserData, evt.subtype, getData(block), block.size);
         }
 
         switch(evt.subtype)
@@ -121,8 +132,10 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
             return;
 
         case MidiEvent::ST_DEVICESWITCH:
-            length = evt.data_block.size > 0 ? evt.data_block.size : static_cast<size_t>(evt.data_loc_size);
-            datau = evt.data_block.size > 0 ? getData(evt.data_block) : evt.data_loc;
+        {
+            const DataBlock &block = getBlock(evt);
+            length = block.size > 0 ? block.size : static_cast<size_t>(evt.data_loc_size);
+            datau = block.size > 0 ? getData(block) : evt.data_loc;
             data = (length ? reinterpret_cast<const char *>(datau) : "\0\0\0\0\0\0\0\0");
 
             if(m_interface->onDebugMessage)
@@ -131,6 +144,7 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
             if(m_interface->rt_deviceSwitch)
                 m_interface->rt_deviceSwitch(m_interface->rtUserData, track, data, length);
             return;
+        }
 
         case MidiEvent::ST_MARKER:
         case MidiEvent::ST_TEXT:
@@ -326,6 +340,9 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
         if(evt.channel < 16 && m_channelDisable[evt.channel])
             return; // Disabled channel
 
+        if(rtBatchPush(0x80, midCh, evt.data_loc[0], evt.data_loc[1]))
+            return;
+
         if(m_interface->rt_noteOff)
             m_interface->rt_noteOff(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0]);
 
@@ -337,7 +354,8 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
     case MidiEvent::T_NOTEON:  // Note on
         if(evt.channel < 16 && m_channelDisable[evt.channel])
             return; // Disabled channel
-        m_interface->rt_noteOn(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0], evt.data_loc[1]);
+        if(!rtBatchPush(0x90, midCh, evt.data_loc[0], evt.data_loc[1]))
+            m_interface->rt_noteOn(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0], evt.data_loc[1]);
         return;
 
     case MidiEvent::T_NOTEON_DURATED: // Note on with duration
@@ -347,33 +365,39 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
             note->note = evt.data_loc[0];
             note->velocity = evt.data_loc[1];
             note->ttl = readBEint(evt.data_loc + 2, 3);
-            m_interface->rt_noteOn(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0], evt.data_loc[1]);
+            if(!rtBatchPush(0x90, midCh, evt.data_loc[0], evt.data_loc[1]))
+                m_interface->rt_noteOn(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0], evt.data_loc[1]);
         }
         return;
 
     case MidiEvent::T_NOTETOUCH: // Note touch
-        m_interface->rt_noteAfterTouch(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0], evt.data_loc[1]);
+        if(!rtBatchPush(0xA0, midCh, evt.data_loc[0], evt.data_loc[1]))
+            m_interface->rt_noteAfterTouch(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0], evt.data_loc[1]);
         tk.state.reserve_note_att[evt.data_loc[0]] = evt.data_loc[1];
         return;
 
     case MidiEvent::T_CTRLCHANGE: // Controller change
-        m_interface->rt_controllerChange(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0], evt.data_loc[1]);
+        if(!rtBatchPush(0xB0, midCh, evt.data_loc[0], evt.data_loc[1]))
+            m_interface->rt_controllerChange(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0], evt.data_loc[1]);
         if(evt.data_loc[0] < 102)
             tk.state.cc_values[evt.data_loc[0]] = evt.data_loc[1];
         return;
 
     case MidiEvent::T_PATCHCHANGE: // Patch change
-        m_interface->rt_patchChange(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0]);
+        if(!rtBatchPush(0xC0, midCh, evt.data_loc[0], 0))
+            m_interface->rt_patchChange(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0]);
         tk.state.reserve_patch = evt.data_loc[0];
         return;
 
     case MidiEvent::T_CHANAFTTOUCH: // Channel after-touch
-        m_interface->rt_channelAfterTouch(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0]);
+        if(!rtBatchPush(0xD0, midCh, evt.data_loc[0], 0))
+            m_interface->rt_channelAfterTouch(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0]);
         tk.state.reserve_channel_att = evt.data_loc[0];
         return;
 
     case MidiEvent::T_WHEEL: // Wheel/pitch bend
-        m_interface->rt_pitchBend(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[1], evt.data_loc[0]);
+        if(!rtBatchPush(0xE0, midCh, evt.data_loc[0], evt.data_loc[1]))
+            m_interface->rt_pitchBend(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[1], evt.data_loc[0]);
         tk.state.reserve_wheel[0] = evt.data_loc[0];
         tk.state.reserve_wheel[1] = evt.data_loc[1];
         return;
@@ -396,11 +420,14 @@ void BW_MidiSequencer::processDuratedNotes(size_t track, int32_t &status)
         {
             DuratedNote *n = &cache.notes[i];
 
-            if(m_interface->rt_noteOff)
-                m_interface->rt_noteOff(m_interface->rtUserData, n->channel, n->note);
+            if(!rtBatchPush(0x80, n->channel, n->note, n->velocity))
+            {
+                if(m_interface->rt_noteOff)
+                    m_interface->rt_noteOff(m_interface->rtUserData, n->channel, n->note);
 
-            if(m_interface->rt_noteOffVel)
-                m_interface->rt_noteOffVel(m_interface->rtUserData, n->channel, n->note, n->velocity);
+                if(m_interface->rt_noteOffVel)
+                    m_interface->rt_noteOffVel(m_interface->rtUserData, n->channel, n->note, n->velocity);
+            }
 
             status = MidiEvent::T_NOTEOFF;
 
@@ -411,13 +438,49 @@ void BW_MidiSequencer::processDuratedNotes(size_t track, int32_t &status)
     }
 }
 
-void BW_MidiSequencer::handleLoopStart(LoopRuntimeState &state, LoopState &loop, Position::TrackInfo &tk, bool glob)
+bool BW_MidiSequencer::rtBatchPush(uint8_t type, size_t channel, uint8_t data1, uint8_t data2)
+{
+    if(!m_interface->rt_eventBatch)
+        return false;
+
+    if(m_rtBatchCount == RT_BATCH_SIZE)
+        rtBatchFlush();
+
+    BW_MidiRtEvent &e = m_rtBatch[m_rtBatchCount];
+    uint32_t offset = 0;
+
+    e.type = type;
+    e.channel = static_cast<uint8_t>(channel);
+    e.data[0] = data1;
+    e.data[1] = data2;
+
+    // The event due a bit later than now gets delayed into the next rendered block
+    if(m_currentPosition.wait > 0.0 && m_interface->pcmSampleRate > 0)
+        offset = static_cast<uint32_t>(m_currentPosition.wait / m_tempoMultiplier * m_interface->pcmSampleRate);
+
+    m_rtBatchOffsets[m_rtBatchCount++] = offset;
+
+    return true;
+}
+
+void BW_MidiSequencer::rtBatchFlush()
+{
+    if(m_rtBatchCount == 0)
+        return;
+
+    m_interface->rt_eventBatch(m_interface->rtUserData, m_rtBatch, m_rtBatchCount, m_rtBatchOffsets);
+    m_rtBatchCount = 0;
+}
+
+void BW_MidiSequencer::handleLoopStart(LoopRuntimeState &state, LoopState &loop, const MidiTrackRow &row, bool glob)
 {
     if(loop.caughtStackStart)
     {
-        // assert(tk.pos);
-        if(glob && m_interface->onloopStart && (m_loopStartTime >= tk.pos->data.time)) // Loop Start hook
+        if(glob && m_interface->onloopStart && (m_loopStartTime >= row.time)) // Loop Start hook
+        {
+            rtBatchFlush();
             m_interface->onloopStart(m_interface->onloopStart_userData);
+        }
 
         state.numStackLoopStarts++;
         loop.caughtStackStart = false;
@@ -430,7 +493,7 @@ void BW_MidiSequencer::handleLoopStart(LoopRuntimeState &state, LoopState &loop,
     }
 }
 
-bool BW_MidiSequencer::handleLoopEnd(LoopRuntimeState &state, LoopState &loop, Position::TrackInfo &tk, bool glob)
+bool BW_MidiSequencer::handleLoopEnd(LoopRuntimeState &state, LoopState &loop, const MidiTrackRow &row, bool glob)
 {
     if(loop.caughtBranchJump)
     {
@@ -449,7 +512,7 @@ bool BW_MidiSequencer::handleLoopEnd(LoopRuntimeState &state, LoopState &loop, P
         {
             loop.caughtStackEnd = false;
             state.numStackLoopEnds++;
-            state.stackLoopEndsTime = tk.pos->data.time;
+            state.stackLoopEndsTime = row.time;
         }
 
         if(glob)
@@ -572,6 +635,8 @@ void BW_MidiSequencer::restoreTrackState(size_t track)
     MidiTrackState &state = m_trackState[track];
     uint8_t chan = state.state.track_channel;
 
+    rtBatchFlush();
+
     if((m_stateRestoreSetup & TRACK_RESTORE_NOTEOFFS) != 0)
     {
         if((m_format == Format_MIDI && m_smfFormat == 0) || m_format == Format_XMIDI)
@@ -681,7 +746,7 @@ bool BW_MidiSequencer::processEvents(bool isSeek)
     for(size_t tk = 0; tk < trackCount; ++tk)
     {
         Position::TrackInfo &track = m_currentPosition.track[tk];
-        // MidiTrackQueue::Leaf_t* end = m_trackData[tk].end();
+        const MidiTrackQueue &trackData = m_trackData[tk];
         MidiTrackState &trackState = m_trackState[tk];
         LoopState &trackLoop = trackState.loop;
 
@@ -693,14 +758,16 @@ bool BW_MidiSequencer::processEvents(bool isSeek)
         if((track.lastHandledEvent >= 0) && (track.delay <= 0))
         {
             // Check is an end of track has been reached
-            if(track.pos == NULL)
+            if(track.pos >= trackData.size)
             {
                 track.lastHandledEvent = -1;
                 break;
             }
 
+            const MidiTrackRow &row = trackData[track.pos];
+
             // Handle event
-            for(size_t i = track.pos->data.events_begin; i < track.pos->data.events_end; ++i)
+            for(size_t i = row.events_begin; i < row.events_end; ++i)
             {
                 const MidiEvent &evt = m_eventBank[i];
 #ifdef ENABLE_BEGIN_SILENCE_SKIPPING
@@ -716,33 +783,36 @@ bool BW_MidiSequencer::processEvents(bool isSeek)
                 if(m_loop.caughtStart)
                 {
                     if(m_interface->onloopStart) // Loop Start hook
+                    {
+                        rtBatchFlush();
                         m_interface->onloopStart(m_interface->onloopStart_userData);
+                    }
 
                     ++loopState.numGlobLoopStarts;
                     m_loop.caughtStart = false;
                 }
 
                 // Global stacked loop start
-                handleLoopStart(loopState, m_loop, track, true);
+                handleLoopStart(loopState, m_loop, row, true);
                 // Local stacked loop start
-                handleLoopStart(loopStateLoc, trackLoop, track, false);
+                handleLoopStart(loopStateLoc, trackLoop, row, false);
 
-                if(handleLoopEnd(loopStateLoc, trackLoop, track, false))
+                if(handleLoopEnd(loopStateLoc, trackLoop, row, false))
                     break;
 
-                if(handleLoopEnd(loopState, m_loop, track, true))
+                if(handleLoopEnd(loopState, m_loop, row, true))
                     break;
             }
 
 #ifdef DEBUG_TIME_CALCULATION
-            if(maxTime < track.pos->time)
-                maxTime = track.pos->time;
+            if(maxTime < row.time)
+                maxTime = row.time;
 #endif
             // Read next event time (unless the track just ended)
             if(track.lastHandledEvent >= 0)
             {
-                track.delay += track.pos->data.delay;
-                track.pos = track.pos->next;
+                track.delay += row.delay;
+                ++track.pos;
             }
 
             // Register global loop start position
@@ -758,6 +828,9 @@ bool BW_MidiSequencer::processEvents(bool isSeek)
         }
     }
 
+    // Deliver channel events of this tick at once
+    rtBatchFlush();
+
 #ifdef DEBUG_TIME_CALCULATION
     std::fprintf(stdout, "                              \r");
     std::fprintf(stdout, "Time: %10f; Audio: %10f\r", maxTime, m_currentPosition.absTimePosition);
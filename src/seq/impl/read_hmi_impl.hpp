@@ -384,7 +384,7 @@ bool BW_MidiSequencer::hmi_parseEvent(const HMIData &hmi_data, const HMITrackDir
 #endif
 
         event.type = MidiEvent::T_SYSEX;
-        insertDataToBankWithByte(event, m_dataBank, byte, fr, length);
+        insertDataToBankWithByte(event, byte, fr, length);
     }
     else if(byte == MidiEvent::T_SPECIAL) // Special event FF
     {
@@ -489,7 +489,7 @@ bool BW_MidiSequencer::hmi_parseEvent(const HMIData &hmi_data, const HMITrackDir
                 return false;
             }
             // Unknown data, possibly offset
-            insertDataToBank(event, m_dataBank, fr, skipSize + 4);
+            insertDataToBank(event, fr, skipSize + 4);
             break;
 
         case ST_HMI_JUMP_TO_LOC_BRANCH: // 6 bytes
@@ -505,7 +505,7 @@ bool BW_MidiSequencer::hmi_parseEvent(const HMIData &hmi_data, const HMITrackDir
             }
 
             // Unknown data, possibly offset
-            insertDataToBank(event, m_dataBank, fr, 4);
+            insertDataToBank(event, fr, 4);
             break;
 
         case ST_HMI_TRACK_LOOP_START: // 2 bytes
@@ -533,7 +533,7 @@ bool BW_MidiSequencer::hmi_parseEvent(const HMIData &hmi_data, const HMITrackDir
             event.subtype = MidiEvent::ST_TRACK_LOOPSTACK_END;
             event.data_loc_size = 0;
             // Unknown data, possibly offset
-            insertDataToBank(event, m_dataBank, fr, 6);
+            insertDataToBank(event, fr, 6);
             break;
 
 
@@ -562,7 +562,7 @@ bool BW_MidiSequencer::hmi_parseEvent(const HMIData &hmi_data, const HMITrackDir
             event.subtype = MidiEvent::ST_LOOPSTACK_END;
             event.data_loc_size = 0;
             // Unknown data, possibly offset
-            insertDataToBank(event, m_dataBank, fr, 6);
+            insertDataToBank(event, fr, 6);
             break;
 
         case ST_HMI_JUMP_TO_GLOB_BRANCH: // 2 bytes
@@ -1410,7 +1410,7 @@ bool BW_MidiSequencer::parseHMI(FileAndMemReader &fr)
             {
                 if(!m_trackData[tk_v].empty())
                 {
-                    MidiTrackRow &previous = m_trackData[tk_v].m_last->data;
+                    MidiTrackRow &previous = *m_trackData[tk_v].back();
                     previous.delay = 0;
                     previous.timeDelay = 0;
                 }
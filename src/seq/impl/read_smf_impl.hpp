@@ -201,7 +201,7 @@ bool BW_MidiSequencer::smf_buildOneTrack(FileAndMemReader &fr,
         {
             if (!m_trackData[track_idx].empty())
             {
-                MidiTrackRow &previous = m_trackData[track_idx].m_last->data;
+                MidiTrackRow &previous = *m_trackData[track_idx].back();
                 previous.delay = 0;
                 previous.timeDelay = 0;
             }
@@ -232,7 +232,7 @@ bool BW_MidiSequencer::smf_buildOneTrack(FileAndMemReader &fr,
         if(m_deviceMask != Device_ANY && (m_deviceMask & trackState.deviceMask) == 0)
         {
             // Exclude this track completely: make it have no events at all
-            m_trackData[track_idx].clean();
+            m_trackData[track_idx].clear();
             trackState.disabled = true;
         }
     }
@@ -284,7 +284,7 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::smf_parseEvent(FileAndMemReader &f
         }
 
         evt.type = MidiEvent::T_SYSEX;
-        insertDataToBankWithByte(evt, m_dataBank, byte, fr, length);
+        insertDataToBankWithByte(evt, byte, fr, length);
         return evt;
     }
 
@@ -343,12 +343,12 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::smf_parseEvent(FileAndMemReader &f
 #endif
             break;
         case MidiEvent::ST_COPYRIGHT:
-            insertDataToBankWithTerm(evt, m_dataBank, fr, length);
-            entry = reinterpret_cast<const char*>(getData(evt.data_block));
+            insertDataToBankWithTerm(evt, fr, length);
+            entry = reinterpret_cast<const char*>(getData(getBlock(evt)));
 
             if(m_musCopyright.size == 0)
             {
-                m_musCopyright = evt.data_block;
+                m_musCopyright = getBlock(evt);
 
                 if(m_interface->onDebugMessage)
                     m_interface->onDebugMessage(m_interface->onDebugMessage_userData, "Music copyright: %s", entry);
@@ -358,18 +358,18 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::smf_parseEvent(FileAndMemReader &f
             break;
 
         case MidiEvent::ST_SQTRKTITLE:
-            insertDataToBankWithTerm(evt, m_dataBank, fr, length);
-            entry = reinterpret_cast<const char*>(getData(evt.data_block));
+            insertDataToBankWithTerm(evt, fr, length);
+            entry = reinterpret_cast<const char*>(getData(getBlock(evt)));
 
             if(m_musTitle.size == 0)
             {
-                m_musTitle = evt.data_block;
+                m_musTitle = getBlock(evt);
                 if(m_interface->onDebugMessage)
                     m_interface->onDebugMessage(m_interface->onDebugMessage_userData, "Music title: %s", entry);
             }
             else
             {
-                m_musTrackTitles.push_back(evt.data_block);
+                m_musTrackTitles.push_back(getBlock(evt));
 
                 if(m_interface->onDebugMessage)
                     m_interface->onDebugMessage(m_interface->onDebugMessage_userData, "Track title: %s", entry);
@@ -377,16 +377,16 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::smf_parseEvent(FileAndMemReader &f
             break;
 
         case MidiEvent::ST_INSTRTITLE:
-            insertDataToBankWithTerm(evt, m_dataBank, fr, length);
-            entry = reinterpret_cast<const char*>(getData(evt.data_block));
+            insertDataToBankWithTerm(evt, fr, length);
+            entry = reinterpret_cast<const char*>(getData(getBlock(evt)));
 
             if(m_interface->onDebugMessage)
                 m_interface->onDebugMessage(m_interface->onDebugMessage_userData, "Instrument: %s", entry);
             break;
 
         case MidiEvent::ST_MARKER:
-            insertDataToBankWithTerm(evt, m_dataBank, fr, length);
-            entry = reinterpret_cast<const char*>(getData(evt.data_block));
+            insertDataToBankWithTerm(evt, fr, length);
+            entry = reinterpret_cast<const char*>(getData(getBlock(evt)));
 
             if(strEqual(entry, length, "loopstart"))
             {
@@ -449,7 +449,7 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::smf_parseEvent(FileAndMemReader &f
             break;
 
         default: // Unknown special event
-            insertDataToBank(evt, m_dataBank, fr, length);
+            insertDataToBank(evt, fr, length);
             break;
         }
 
@@ -0,0 +1,374 @@
+/*
+ * BW_Midi_Sequencer - MIDI Sequencer for C++
+ *
+ * Copyright (c) 2015-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#ifndef BW_MIDISEQ_SEEK_INDEX_IMPL_HPP
+#define BW_MIDISEQ_SEEK_INDEX_IMPL_HPP
+
+#include <cstring>
+
+#include "../midi_sequencer.hpp"
+
+
+/**********************************************************************************
+ *                        Recorder of the channels state                          *
+ **********************************************************************************/
+
+void BW_MidiSequencer::seekRecNoteOn(void *, uint8_t, uint8_t, uint8_t)
+{
+    // Notes are skipped while seeking
+}
+
+void BW_MidiSequencer::seekRecNoteAfterTouch(void *, uint8_t, uint8_t, uint8_t)
+{
+    // Pressure of notes has no sense without notes themselves
+}
+
+void BW_MidiSequencer::seekRecChannelAfterTouch(void *userdata, uint8_t channel, uint8_t atVal)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+
+    if(channel < 16)
+        self->m_seekChannels[channel].channel_att = atVal;
+}
+
+void BW_MidiSequencer::seekRecControllerChange(void *userdata, uint8_t channel, uint8_t type, uint8_t value)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+
+    if(channel >= 16 || type > 127)
+        return;
+
+    SeekChannelState &st = self->m_seekChannels[channel];
+
+    switch(type)
+    {
+    case 6:  // Data entry MSB
+    case 38: // Data entry LSB
+        if(st.param_mode == 1 && st.cc[101] == 0 && st.cc[100] < 6)
+            st.rpn[st.cc[100]][type == 38] = value;
+        else if(st.param_mode == 2)
+            st.nrpn[type == 38] = value;
+        break;
+
+    case 96:  // Data increment
+    case 97:  // Data decrement
+    case 120: // All sounds off
+    case 123: // All notes off
+        break;
+
+    case 98: // NRPN LSB
+    case 99: // NRPN MSB
+        st.cc[type] = value;
+        st.param_mode = 2;
+        st.nrpn[0] = 0xFF;
+        st.nrpn[1] = 0xFF;
+        break;
+
+    case 100: // RPN LSB
+    case 101: // RPN MSB
+        st.cc[type] = value;
+        st.param_mode = 1;
+        break;
+
+    case 121: // Reset all controllers, the set of controllers follows the RP-015
+        st.reset = true;
+        st.cc[1] = 0xFF;
+        st.cc[11] = 0xFF;
+        std::memset(st.cc + 64, 0xFF, 4);
+        std::memset(st.cc + 98, 0xFF, 4);
+        st.param_mode = 0;
+        st.wheel[0] = 0xFF;
+        st.wheel[1] = 0xFF;
+        st.channel_att = 0xFF;
+        break;
+
+    default:
+        st.cc[type] = value;
+        break;
+    }
+}
+
+void BW_MidiSequencer::seekRecPatchChange(void *userdata, uint8_t channel, uint8_t patch)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+
+    if(channel < 16)
+        self->m_seekChannels[channel].patch = patch;
+}
+
+void BW_MidiSequencer::seekRecPitchBend(void *userdata, uint8_t channel, uint8_t msb, uint8_t lsb)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+
+    if(channel < 16)
+    {
+        self->m_seekChannels[channel].wheel[0] = msb;
+        self->m_seekChannels[channel].wheel[1] = lsb;
+    }
+}
+
+void BW_MidiSequencer::seekRecSysEx(void *userdata, const uint8_t *msg, size_t size)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    DataBlock block;
+
+    if(msg < self->m_dataBank.begin() || msg + size > self->m_dataBank.end())
+    {
+        self->m_seekIndexState = SEEK_INDEX_UNUSABLE;
+        return;
+    }
+
+    block.offset = static_cast<size_t>(msg - self->m_dataBank.begin());
+    block.size = size;
+    self->m_seekSysEx.push_back(block);
+}
+
+void BW_MidiSequencer::seekRecDeviceSwitch(void *userdata, size_t, const char *, size_t)
+{
+    // The state of the device is unknown, it can't be restored from the index
+    reinterpret_cast<BW_MidiSequencer *>(userdata)->m_seekIndexState = SEEK_INDEX_UNUSABLE;
+}
+
+void BW_MidiSequencer::seekRecRawOPL(void *userdata, uint8_t, uint8_t)
+{
+    // Chip registers are not tracked, so raw OPL songs always get replayed from the begin
+    reinterpret_cast<BW_MidiSequencer *>(userdata)->m_seekIndexState = SEEK_INDEX_UNUSABLE;
+}
+
+
+
+/**********************************************************************************
+ *                                 Seek index                                     *
+ **********************************************************************************/
+
+void BW_MidiSequencer::seekIndexClear()
+{
+    m_seekIndex.clear();
+    m_seekTrackStates.clear();
+    m_seekSysEx.clear();
+    m_seekIndexState = SEEK_INDEX_NONE;
+}
+
+void BW_MidiSequencer::seekIndexBuild()
+{
+    const BW_MidiRtInterface *intrf = m_interface;
+    BW_MidiRtInterface recorder;
+    TriggerHandler triggerHandler = m_triggerHandler;
+    bool loopFlagState = m_loopEnabled;
+    Tempo_t tempo = m_tempo;
+    uint32_t stateRestoreSetup = m_stateRestoreSetup;
+    double nextTime = m_seekIndexInterval;
+
+    seekIndexClear();
+
+    // Channels offset of the device can't be restored from the index
+    if(m_seekIndexInterval <= 0.0 || intrf->rt_currentDevice)
+    {
+        m_seekIndexState = SEEK_INDEX_UNUSABLE;
+        return;
+    }
+
+    std::memset(&recorder, 0, sizeof(BW_MidiRtInterface));
+    recorder.rtUserData = this;
+    recorder.rt_noteOn = seekRecNoteOn;
+    recorder.rt_noteAfterTouch = seekRecNoteAfterTouch;
+    recorder.rt_channelAfterTouch = seekRecChannelAfterTouch;
+    recorder.rt_controllerChange = seekRecControllerChange;
+    recorder.rt_patchChange = seekRecPatchChange;
+    recorder.rt_pitchBend = seekRecPitchBend;
+    recorder.rt_systemExclusive = seekRecSysEx;
+
+    if(intrf->rt_deviceSwitch)
+        recorder.rt_deviceSwitch = seekRecDeviceSwitch;
+
+    if(intrf->rt_rawOPL)
+        recorder.rt_rawOPL = seekRecRawOPL;
+
+    std::memset(m_seekChannels, 0xFF, sizeof(m_seekChannels));
+    for(size_t i = 0; i < 16; ++i)
+    {
+        m_seekChannels[i].param_mode = 0;
+        m_seekChannels[i].reset = false;
+    }
+
+    m_interface = &recorder;
+    m_triggerHandler = NULL;
+    m_loopEnabled = false;
+
+    // Walk the song the same way as the seek does
+    this->rewind();
+    m_loop.caughtStart = false;
+    m_seekIndexState = SEEK_INDEX_BUILDING;
+
+    while(m_seekIndexState == SEEK_INDEX_BUILDING && processEvents(true) && !m_atEnd)
+    {
+        if(m_currentPosition.wait < nextTime)
+            continue;
+
+        seekIndexAddCheckpoint();
+
+        while(nextTime <= m_currentPosition.wait)
+            nextTime += m_seekIndexInterval;
+    }
+
+    if(m_seekIndexState == SEEK_INDEX_BUILDING)
+    {
+        m_seekIndex.shrink_to_fit();
+        m_seekTrackStates.shrink_to_fit();
+        m_seekSysEx.shrink_to_fit();
+        m_seekIndexState = SEEK_INDEX_READY;
+    }
+    else
+    {
+        seekIndexClear();
+        m_seekIndexState = SEEK_INDEX_UNUSABLE;
+    }
+
+    m_interface = intrf;
+    m_triggerHandler = triggerHandler;
+    m_loopEnabled = loopFlagState;
+    m_tempo = tempo;
+    m_stateRestoreSetup = stateRestoreSetup;
+}
+
+void BW_MidiSequencer::seekIndexAddCheckpoint()
+{
+    SeekCheckpoint *cp;
+
+    m_seekIndex.resize(m_seekIndex.size + 1);
+    cp = m_seekIndex.back();
+
+    cp->time = m_currentPosition.wait;
+    cp->position = m_currentPosition;
+    cp->tempo = m_tempo;
+    cp->stateRestoreSetup = m_stateRestoreSetup;
+    cp->sysExCount = m_seekSysEx.size;
+    std::memcpy(cp->channels, m_seekChannels, sizeof(m_seekChannels));
+
+    for(size_t tk = 0; tk < m_tracksCount; ++tk)
+        m_seekTrackStates.push_back(m_trackState[tk].state);
+}
+
+void BW_MidiSequencer::seekIndexRestore(double time)
+{
+    size_t lo = 0, hi = m_seekIndex.size, mid;
+
+    // Find the first checkpoint later than the time
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+
+        if(m_seekIndex[mid].time <= time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if(lo == 0)
+        return; // Nothing to skip, the song begin is closer
+
+    const size_t idx = lo - 1;
+    const SeekCheckpoint &cp = m_seekIndex[idx];
+
+    m_currentPosition = cp.position;
+    m_tempo = cp.tempo;
+    m_stateRestoreSetup = cp.stateRestoreSetup;
+
+    for(size_t tk = 0; tk < m_tracksCount; ++tk)
+        std::memcpy(&m_trackState[tk].state, &m_seekTrackStates[idx * m_tracksCount + tk], sizeof(TrackStateSaved));
+
+    for(size_t i = 0; i < cp.sysExCount; ++i)
+        m_interface->rt_systemExclusive(m_interface->rtUserData, getData(m_seekSysEx[i]), m_seekSysEx[i].size);
+
+    for(size_t ch = 0; ch < 16; ++ch)
+        seekIndexSendChannel(static_cast<uint8_t>(ch), cp.channels[ch]);
+}
+
+void BW_MidiSequencer::seekIndexSendChannel(uint8_t channel, const SeekChannelState &st)
+{
+    const BW_MidiRtInterface *i = m_interface;
+
+    // Registered parameters are kept by the controllers reset
+    for(uint8_t p = 0; p < 6; ++p)
+    {
+        if(st.rpn[p][0] > 127)
+            continue;
+
+        i->rt_controllerChange(i->rtUserData, channel, 101, 0);
+        i->rt_controllerChange(i->rtUserData, channel, 100, p);
+        i->rt_controllerChange(i->rtUserData, channel, 6, st.rpn[p][0]);
+
+        if(st.rpn[p][1] <= 127)
+            i->rt_controllerChange(i->rtUserData, channel, 38, st.rpn[p][1]);
+    }
+
+    if(st.reset)
+        i->rt_controllerChange(i->rtUserData, channel, 121, 0);
+
+    // Bank select goes before the patch change
+    for(uint8_t cc = 0; cc < 128; ++cc)
+    {
+        if(cc == 6 || cc == 38 || (cc >= 96 && cc <= 101) || cc == 120 || cc == 121 || cc == 123)
+            continue;
+
+        if(st.cc[cc] <= 127)
+            i->rt_controllerChange(i->rtUserData, channel, cc, st.cc[cc]);
+    }
+
+    // The parameter selected at the checkpoint goes last
+    if(st.param_mode != 0)
+    {
+        static const uint8_t params[2][4] = {{99, 98, 101, 100}, {101, 100, 99, 98}};
+        const uint8_t *order = params[st.param_mode - 1];
+
+        for(size_t p = 0; p < 4; ++p)
+        {
+            if(st.cc[order[p]] <= 127)
+                i->rt_controllerChange(i->rtUserData, channel, order[p], st.cc[order[p]]);
+        }
+
+        if(st.param_mode == 2 && st.nrpn[0] <= 127)
+            i->rt_controllerChange(i->rtUserData, channel, 6, st.nrpn[0]);
+        if(st.param_mode == 2 && st.nrpn[1] <= 127)
+            i->rt_controllerChange(i->rtUserData, channel, 38, st.nrpn[1]);
+    }
+
+    if(st.patch <= 127)
+        i->rt_patchChange(i->rtUserData, channel, st.patch);
+
+    if(st.wheel[0] <= 127)
+        i->rt_pitchBend(i->rtUserData, channel, st.wheel[0], st.wheel[1]);
+
+    if(st.channel_att <= 127)
+        i->rt_channelAfterTouch(i->rtUserData, channel, st.channel_att);
+}
+
+void BW_MidiSequencer::setSeekIndexInterval(double seconds)
+{
+    m_seekIndexInterval = seconds;
+    seekIndexClear();
+}
+
+#endif /* BW_MIDISEQ_SEEK_INDEX_IMPL_HPP */
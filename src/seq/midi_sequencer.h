@@ -73,6 +73,21 @@ typedef size_t (*RtCurrentDevice)(void *userdata, size_t track);
 /*! [Non-Standard] Pass raw OPL3 data to the chip (when playing IMF files) */
 typedef void (*RtRawOPL)(void *userdata, uint8_t reg, uint8_t value);
 
+/*! Channel MIDI event delivered through the batch hook */
+typedef struct BW_MidiRtEvent
+{
+    /*! MIDI status without the channel: 0x80 (note off), 0x90 (note on), 0xA0 (note aftertouch),
+        0xB0 (controller), 0xC0 (patch), 0xD0 (channel aftertouch), 0xE0 (pitch bend) */
+    uint8_t type;
+    /*! Channel number including the offset of the current device */
+    uint8_t channel;
+    /*! Data bytes in the order of the MIDI message (the pitch bend gives LSB first) */
+    uint8_t data[2];
+} BW_MidiRtEvent;
+
+/*! Channel MIDI events handled at once, every one with the count of frames to delay it into the next rendered block */
+typedef void (*RtEventBatch)(void *userdata, const BW_MidiRtEvent *events, size_t count, const uint32_t *sampleOffsets);
+
 /**
   \brief Real-Time MIDI interface between Sequencer and the Synthesizer
  */
@@ -162,6 +177,11 @@ typedef struct BW_MidiRtInterface
     /*! Get the channels offset for current MIDI device hook. Returms multiple to 16 value. */
     RtCurrentDevice     rt_currentDevice;
 
+    /*! Channel events batch hook. When set, it receives channel events of every
+        processed tick in one call instead of the Note-On, Note-Off, Aftertouch,
+        Controller change, Patch change and Pitch bend hooks */
+    RtEventBatch        rt_eventBatch;
+
 
     /******************************************
      * NonStandard events. There are optional *
@@ -29,7 +29,6 @@
 #include "file_reader.hpp"
 #include "midi_sequencer.h"
 
-#include "impl/miditrack_list.hpp"
 #include "impl/miditrack_arr.hpp"
 
 //! Helper for unused values
@@ -370,23 +369,39 @@ private:
             ST_TYPE_LAST = ST_TRACK_BRANCH_TO
         };
 
+        /*
+         * Fields are packed into 16 bytes to keep the event bank small
+         * and the dispatch loop walking it cache-friendly
+         */
+
         //! Main type of event
-        uint_fast16_t type;
+        uint16_t type;
         //! Sub-type of the event
-        uint_fast16_t subtype;
+        uint16_t subtype;
         //! Targeted MIDI channel
-        uint_fast16_t channel;
+        uint8_t channel;
         //! Is valid event
-        uint_fast16_t isValid;
-        //! 4 bytes of locally placed data bytes
-        uint8_t data_loc[5];
+        uint8_t isValid;
+        //! Count of locally placed data bytes
         uint8_t data_loc_size;
-        //! Larger data blocks such as SysEx queries
-        DataBlock data_block;
+        //! 5 bytes of locally placed data bytes
+        uint8_t data_loc[5];
+        //! Index of larger data block (such as SysEx queries) in the blocks list, 0 if none
+        uint32_t data_block;
     };
 
     typedef miditrack_arr<MidiEvent> MidiEventsList;
 
+    /*!
+     * \brief Get the larger data block of the event
+     * \param evt Event entry
+     * \return Data block reference, zero sized when the event has no data block
+     */
+    inline const DataBlock &getBlock(const MidiEvent &evt) const
+    {
+        return m_dataBlocks[evt.data_block];
+    }
+
     /*!
      * \brief Individual tempo value used for the timeline calculation
      */
@@ -456,7 +471,8 @@ private:
     };
     //P.S. I declared it here instead of local in-function because C++98 can't process templates with locally-declared structures
 
-    typedef TrackQueueList_t<MidiTrackRow> MidiTrackQueue;
+    //! Rows of one track, stored contiguously in the order of playback
+    typedef miditrack_arr<MidiTrackRow> MidiTrackQueue;
 
     /**
      * @brief The print left by the Note-On event with a duration supplied. Once it expires, the Note-Off event should be sent.
@@ -526,8 +542,8 @@ private:
         //! Track information
         struct TrackInfo
         {
-            //! MIDI Events queue position iterator
-            MidiTrackQueue::Leaf_t *pos;
+            //! Index of the current row in the track data, equal to the track size at the end
+            size_t pos;
             //! Delay to next event in a track
             uint64_t delay;
             //! Last handled event type
@@ -759,6 +775,63 @@ private:
         MidiTrackState();
     };
 
+    /**
+     * @brief Accumulated state of the MIDI channel, remembered by the seek index
+     *
+     * Every field is 0xFF while the value was never set.
+     */
+    struct SeekChannelState
+    {
+        //! Values of controllers
+        uint8_t cc[128];
+        //! Data entry values (MSB and LSB) of registered parameters 0...5
+        uint8_t rpn[6][2];
+        //! Data entry values (MSB and LSB) of the currently selected non-registered parameter
+        uint8_t nrpn[2];
+        //! Kind of the parameter selected by the last CC 98...101: 0 - none, 1 - RPN, 2 - NRPN
+        uint8_t param_mode;
+        //! Current patch
+        uint8_t patch;
+        //! Pitch bend value (MSB and LSB)
+        uint8_t wheel[2];
+        //! Channel after-touch
+        uint8_t channel_att;
+        //! Was the "Reset all controllers" ever sent
+        bool reset;
+    };
+
+    /**
+     * @brief Snapshot of the song state at the moment while seeking
+     */
+    struct SeekCheckpoint
+    {
+        //! Song time of the snapshot in seconds, the same as the position's waiting time
+        double time;
+        //! Position of the song
+        Position position;
+        //! Current tempo
+        Tempo_t tempo;
+        //! Song-wide on-loop state restore setup
+        uint32_t stateRestoreSetup;
+        //! Count of SysEx messages met before the snapshot
+        size_t sysExCount;
+        //! State of every MIDI channel
+        SeekChannelState channels[16];
+    };
+
+    //! State of the seek index
+    enum SeekIndexState
+    {
+        //! The index was not built yet for the current song and setup
+        SEEK_INDEX_NONE = 0,
+        //! The index is getting built right now
+        SEEK_INDEX_BUILDING,
+        //! The index is ready to use
+        SEEK_INDEX_READY,
+        //! The song can't be indexed, every seek replays it from the begin
+        SEEK_INDEX_UNUSABLE
+    };
+
     /**********************************************************************************
      *                      Private variable fields definitions                       *
      **********************************************************************************/
@@ -766,11 +839,27 @@ private:
     //! MIDI Output interface context
     const BW_MidiRtInterface *m_interface;
 
+    //! Capacity of the channel events batch
+    enum { RT_BATCH_SIZE = 64 };
+    //! Channel events of the current tick to deliver through the batch hook
+    BW_MidiRtEvent m_rtBatch[RT_BATCH_SIZE];
+    //! Delays of batched events in frames
+    uint32_t m_rtBatchOffsets[RT_BATCH_SIZE];
+    //! Count of batched events
+    size_t m_rtBatchCount;
+
+    //! Storage of the loaded song's data, released at once on the next load
+    miditrack_arena m_songArena;
+
     typedef miditrack_arr<uint8_t> U8List;
 
     //! Storage of data block refered in tracks
     U8List m_dataBank;
 
+    typedef miditrack_arr<DataBlock> DataBlocksList;
+    //! Data blocks of events in the data bank, the first entry is the empty one
+    DataBlocksList m_dataBlocks;
+
     //! Array of all MIDI events across all tracks
     MidiEventsList m_eventBank;
 
@@ -878,6 +967,25 @@ private:
     //! MIDI channel disable (exception for extra port-prefix-based channels)
     bool m_channelDisable[16];
 
+    //! Distance between checkpoints of the seek index in seconds, 0 disables the index
+    double m_seekIndexInterval;
+    //! State of the seek index
+    SeekIndexState m_seekIndexState;
+
+    typedef miditrack_arr<SeekCheckpoint, true> SeekCheckpointsList;
+    //! Checkpoints of the seek index, ordered by time
+    SeekCheckpointsList m_seekIndex;
+
+    typedef miditrack_arr<TrackStateSaved> TrackStatesList;
+    //! Track states of checkpoints, one entry per track for every checkpoint
+    TrackStatesList m_seekTrackStates;
+
+    //! SysEx messages in the order of sending, that met while building the index
+    DataBlocksList m_seekSysEx;
+
+    //! Channel states accumulated while building the index
+    SeekChannelState m_seekChannels[16];
+
 
     // KEEP HERE AS A GLOBAL STATE
 
@@ -968,12 +1076,18 @@ private:
     /**********************************************************************************
      *                                 Data bank                                      *
      **********************************************************************************/
-    static void insertDataToBank(MidiEvent &evt, U8List &bank, const uint8_t *data, size_t length);
-    static void insertDataToBank(MidiEvent &evt, U8List &bank, FileAndMemReader &fr, size_t length);
-    static void insertDataToBankWithByte(MidiEvent &evt, U8List &bank, uint8_t begin_byte, const uint8_t *data, size_t length);
-    static void insertDataToBankWithByte(MidiEvent &evt, U8List &bank, uint8_t begin_byte, FileAndMemReader &fr, size_t length);
-    static void insertDataToBankWithTerm(MidiEvent &evt, U8List &bank, const uint8_t *data, size_t length);
-    static void insertDataToBankWithTerm(MidiEvent &evt, U8List &bank, FileAndMemReader &fr, size_t length);
+    void insertDataToBank(MidiEvent &evt, const uint8_t *data, size_t length);
+    void insertDataToBank(MidiEvent &evt, FileAndMemReader &fr, size_t length);
+    void insertDataToBankWithByte(MidiEvent &evt, uint8_t begin_byte, const uint8_t *data, size_t length);
+    void insertDataToBankWithByte(MidiEvent &evt, uint8_t begin_byte, FileAndMemReader &fr, size_t length);
+    void insertDataToBankWithTerm(MidiEvent &evt, const uint8_t *data, size_t length);
+    void insertDataToBankWithTerm(MidiEvent &evt, FileAndMemReader &fr, size_t length);
+    /**
+     * @brief Attach the data bank's tail starting at the offset to the event
+     * @param evt Event to attach the data block to
+     * @param offset Beginning of the block in the data bank
+     */
+    void attachDataBlock(MidiEvent &evt, size_t offset);
     void addEventToBank(MidiTrackRow &row, const MidiEvent &evt);
 
 
@@ -1028,24 +1142,39 @@ private:
      */
     void processDuratedNotes(size_t track, int32_t &status);
 
+    /**
+     * @brief Queue the channel event to deliver through the batch hook
+     * @param type MIDI status of the event without the channel
+     * @param channel Channel number including the device offset
+     * @param data1 First data byte
+     * @param data2 Second data byte
+     * @return false if the batch hook is not set and the event must be passed to its own hook
+     */
+    bool rtBatchPush(uint8_t type, size_t channel, uint8_t data1, uint8_t data2);
+
+    /**
+     * @brief Deliver all queued channel events through the batch hook
+     */
+    void rtBatchFlush();
+
     /**
      * @brief Check the state of caught loop start points
      * @param state Runtime state (for the track or for the global row)
      * @param loop Loop state (for the track or for the entire song)
-     * @param tk Track info structure
+     * @param row Currently handled row of the track
      * @param glob Is global loop or local?
      */
-    void handleLoopStart(LoopRuntimeState &state, LoopState &loop, Position::TrackInfo &tk, bool glob);
+    void handleLoopStart(LoopRuntimeState &state, LoopState &loop, const MidiTrackRow &row, bool glob);
 
     /**
      * @brief Check the state of caught loop end points
      * @param state Runtime state (for the track or for the global row)
      * @param loop Loop state (for the track or for the entire song)
-     * @param tk Track info structure
+     * @param row Currently handled row of the track
      * @param glob Is global loop or local?
      * @return true if it's required to stop further handling of events in this row (track or entire row)
      */
-    bool handleLoopEnd(LoopRuntimeState &state, LoopState &loop, Position::TrackInfo &tk, bool glob);
+    bool handleLoopEnd(LoopRuntimeState &state, LoopState &loop, const MidiTrackRow &row, bool glob);
 
 
 
@@ -1090,6 +1219,54 @@ private:
     bool processEvents(bool isSeek = false);
 
 
+    /**********************************************************************************
+     *                                 Seek index                                     *
+     **********************************************************************************/
+
+    /**
+     * @brief Drop the seek index, it gets built again on the next seek
+     */
+    void seekIndexClear();
+
+    /**
+     * @brief Walk the song and remember its state at every checkpoint interval
+     *
+     * Nothing gets sent to the output interface. The position is left at the
+     * end of the song, so the caller must rewind it after.
+     */
+    void seekIndexBuild();
+
+    /**
+     * @brief Remember the current state of the song as a new checkpoint
+     */
+    void seekIndexAddCheckpoint();
+
+    /**
+     * @brief Restore the latest checkpoint that is not later than the given time
+     * @param time Song time in seconds
+     *
+     * Must be called right after rewind. The state of all channels gets sent to the output interface.
+     */
+    void seekIndexRestore(double time);
+
+    /**
+     * @brief Send the remembered state of the MIDI channel to the output interface
+     * @param channel MIDI channel
+     * @param st Channel state
+     */
+    void seekIndexSendChannel(uint8_t channel, const SeekChannelState &st);
+
+    static void seekRecNoteOn(void *userdata, uint8_t channel, uint8_t note, uint8_t velocity);
+    static void seekRecNoteAfterTouch(void *userdata, uint8_t channel, uint8_t note, uint8_t atVal);
+    static void seekRecChannelAfterTouch(void *userdata, uint8_t channel, uint8_t atVal);
+    static void seekRecControllerChange(void *userdata, uint8_t channel, uint8_t type, uint8_t value);
+    static void seekRecPatchChange(void *userdata, uint8_t channel, uint8_t patch);
+    static void seekRecPitchBend(void *userdata, uint8_t channel, uint8_t msb, uint8_t lsb);
+    static void seekRecSysEx(void *userdata, const uint8_t *msg, size_t size);
+    static void seekRecDeviceSwitch(void *userdata, size_t track, const char *data, size_t length);
+    static void seekRecRawOPL(void *userdata, uint8_t reg, uint8_t value);
+
+
     /**********************************************************************************
      *                             Private file parser functions                      *
      **********************************************************************************/
@@ -1539,6 +1716,15 @@ public:
      */
     double seek(double seconds, const double granularity);
 
+    /**
+     * @brief Set the distance between checkpoints of the seek index
+     * @param seconds Distance in seconds, 0 to disable the index
+     *
+     * The index gets built on the first seek and lets every next seek to start
+     * from the nearest checkpoint instead of the song begin. Default is 10 seconds.
+     */
+    void setSeekIndexInterval(double seconds);
+
     /**
      * @brief Gives current time position in seconds
      * @return Current time position in seconds
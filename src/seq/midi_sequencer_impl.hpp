@@ -46,6 +46,7 @@
 #include "impl/process_impl.hpp"
 
 #include "impl/io_impl.hpp"
+#include "impl/seek_index_impl.hpp"
 #include "impl/load_music_impl.hpp"
 #ifdef BWMIDI_ENABLE_DEBUG_SONG_DUMP
 #include "impl/debug_songdump.hpp"
@@ -94,6 +95,7 @@ void BW_MidiSequencer::SequencerTime::reset()
 
 BW_MidiSequencer::BW_MidiSequencer() :
     m_interface(NULL),
+    m_rtBatchCount(0),
     m_loadTrackNumber(0),
     m_triggerHandler(NULL),
     m_triggerUserData(NULL),
@@ -112,6 +114,8 @@ BW_MidiSequencer::BW_MidiSequencer() :
     m_deviceMask(Device_ANY),
     m_deviceMaskAvailable(Device_ANY),
     m_trackSolo(~static_cast<size_t>(0)),
+    m_seekIndexInterval(10.0),
+    m_seekIndexState(SEEK_INDEX_NONE),
     m_tempoMultiplier(1.0)
 {
     m_loop.reset();
@@ -124,6 +128,16 @@ BW_MidiSequencer::BW_MidiSequencer() :
     m_invDeltaTicks.nom = 0;
     m_invDeltaTicks.denom = 1;
 
+    // Data of the loaded song gets allocated from the arena
+    m_dataBank.set_arena(&m_songArena);
+    m_dataBlocks.set_arena(&m_songArena);
+    m_eventBank.set_arena(&m_songArena);
+    m_trackData.set_arena(&m_songArena);
+    m_trackState.set_arena(&m_songArena);
+    m_branches.set_arena(&m_songArena);
+    m_musTrackTitles.set_arena(&m_songArena);
+    m_musMarkers.set_arena(&m_songArena);
+
 #if defined(__DJGPP__)
     dpmi_allocator_impl::dpmi_lock_memory(this, sizeof(BW_MidiSequencer));
 
@@ -142,6 +156,8 @@ BW_MidiSequencer::BW_MidiSequencer() :
     midi_dpmi_lock_class_code<MidiTrackStateList>();
     midi_dpmi_lock_class_code<BranchesList>();
     midi_dpmi_lock_class_code<TemposList>();
+    midi_dpmi_lock_class_code<SeekCheckpointsList>();
+    midi_dpmi_lock_class_code<TrackStatesList>();
 
     midi_dpmi_lock_class_code<MidiTrackQueue>();
 #endif
@@ -167,6 +183,8 @@ BW_MidiSequencer::~BW_MidiSequencer()
     midi_dpmi_unlock_class_code<MidiTrackStateList>();
     midi_dpmi_unlock_class_code<BranchesList>();
     midi_dpmi_unlock_class_code<TemposList>();
+    midi_dpmi_unlock_class_code<SeekCheckpointsList>();
+    midi_dpmi_unlock_class_code<TrackStatesList>();
 
     midi_dpmi_unlock_class_code<MidiTrackQueue>();
 #endif
@@ -203,6 +221,7 @@ void BW_MidiSequencer::setInterface(const BW_MidiRtInterface *intrf)
     }
 
     m_interface = intrf;
+    seekIndexClear();
 }
 
 BW_MidiSequencer::FileFormat BW_MidiSequencer::getFormat()
@@ -221,6 +240,9 @@ bool BW_MidiSequencer::setTrackEnabled(size_t track, bool enable)
     if(track >= trackCount)
         return false;
 
+    if(m_trackState[track].disabled != !enable)
+        seekIndexClear();
+
     m_trackState[track].disabled = !enable;
     return true;
 }
@@ -254,6 +276,9 @@ bool BW_MidiSequencer::setChannelEnabled(size_t channel, bool enable)
 
 void BW_MidiSequencer::setSoloTrack(size_t track)
 {
+    if(m_trackSolo != track)
+        seekIndexClear();
+
     m_trackSolo = track;
 }
 
@@ -289,6 +314,9 @@ void BW_MidiSequencer::setSongNum(int track)
 
 void BW_MidiSequencer::setDeviceMask(uint32_t devMask)
 {
+    if(m_deviceMask != devMask)
+        seekIndexClear();
+
     m_deviceMask = devMask;
 }
 
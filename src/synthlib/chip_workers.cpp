@@ -0,0 +1,160 @@
+//
+// Copyright(C) 2025-2026 Vitaliy Novichkov
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include <stdint.h>
+#include "chip_workers.h"
+#include "../interface.h"
+
+ChipWorkers::~ChipWorkers()
+{
+    stop();
+}
+
+void ChipWorkers::start(fm_chip *const *chips, unsigned int count)
+{
+    stop();
+
+    m_main_chip = chips[0];
+    m_quit = false;
+    m_block = 0;
+
+    for(unsigned int i = 1; i < count; ++i)
+    {
+        m_workers.emplace_back(new Worker);
+        Worker *w = m_workers.back().get();
+        w->chip = chips[i];
+        w->thread = std::thread(&ChipWorkers::workerLoop, this, w);
+    }
+}
+
+void ChipWorkers::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_quit = true;
+    }
+    m_start.notify_all();
+
+    for(auto &w : m_workers)
+        w->thread.join();
+
+    m_workers.clear();
+    m_main_chip = nullptr;
+}
+
+void ChipWorkers::workerLoop(Worker *w)
+{
+    unsigned long block = 0;
+    std::unique_lock<std::mutex> lock(m_lock);
+
+    while(true)
+    {
+        m_start.wait(lock, [&]{ return m_quit || m_block != block; });
+
+        if(m_quit)
+            return;
+
+        block = m_block;
+        const unsigned int length = m_length;
+        const bool is_float = m_float;
+        lock.unlock();
+
+        if(is_float)
+        {
+            if(w->buffer_float.size() < length * 2)
+                w->buffer_float.resize(length * 2);
+            w->chip->fm_generate_float(w->buffer_float.data(), length);
+        }
+        else
+        {
+            if(w->buffer.size() < length * 2)
+                w->buffer.resize(length * 2);
+            w->chip->fm_generate(w->buffer.data(), length);
+        }
+
+        lock.lock();
+        if(--m_pending == 0)
+            m_done.notify_one();
+    }
+}
+
+void ChipWorkers::runBlock(unsigned int length, bool is_float)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_length = length;
+        m_float = is_float;
+        m_pending = static_cast<unsigned int>(m_workers.size());
+        ++m_block;
+    }
+    m_start.notify_all();
+}
+
+void ChipWorkers::generate(int *buffer, unsigned int length)
+{
+    const unsigned int samples = length * 2;
+
+    if(m_workers.empty())
+    {
+        m_main_chip->fm_generate(buffer, length);
+        return;
+    }
+
+    runBlock(length, false);
+    m_main_chip->fm_generate(buffer, length);
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_done.wait(lock, [&]{ return m_pending == 0; });
+    lock.unlock();
+
+    for(auto &w : m_workers)
+    {
+        const int *in = w->buffer.data();
+
+        for(unsigned int i = 0; i < samples; ++i)
+        {
+            int64_t s = static_cast<int64_t>(buffer[i]) + in[i];
+            s = s > INT32_MAX ? INT32_MAX : s;
+            s = s < INT32_MIN ? INT32_MIN : s;
+            buffer[i] = static_cast<int>(s);
+        }
+    }
+}
+
+void ChipWorkers::generate_float(float *buffer, unsigned int length)
+{
+    const unsigned int samples = length * 2;
+
+    if(m_workers.empty())
+    {
+        m_main_chip->fm_generate_float(buffer, length);
+        return;
+    }
+
+    runBlock(length, true);
+    m_main_chip->fm_generate_float(buffer, length);
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_done.wait(lock, [&]{ return m_pending == 0; });
+    lock.unlock();
+
+    // The output gets clipped later, at the conversion into the device format
+    for(auto &w : m_workers)
+    {
+        const float *in = w->buffer_float.data();
+
+        for(unsigned int i = 0; i < samples; ++i)
+            buffer[i] += in[i];
+    }
+}
@@ -0,0 +1,93 @@
+//
+// Copyright(C) 2025-2026 Vitaliy Novichkov
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef CHIP_WORKERS_H
+#define CHIP_WORKERS_H
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class fm_chip;
+
+/**
+ * @brief Renders several chips at once and mixes their outputs
+ *
+ * The first chip gets rendered by the calling thread, every other one by its
+ * own worker thread. Registers of chips must only be written between the
+ * generate calls.
+ */
+class ChipWorkers
+{
+    struct Worker
+    {
+        fm_chip *chip = nullptr;
+        std::vector<int> buffer;
+        std::vector<float> buffer_float;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    fm_chip *m_main_chip = nullptr;
+
+    std::mutex m_lock;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    // Sequence number of the current block, workers wait for it to change
+    unsigned long m_block = 0;
+    unsigned int m_pending = 0;
+    unsigned int m_length = 0;
+    bool m_float = false;
+    bool m_quit = false;
+
+    void workerLoop(Worker *w);
+    void runBlock(unsigned int length, bool is_float);
+
+public:
+    ChipWorkers() = default;
+    ~ChipWorkers();
+
+    ChipWorkers(const ChipWorkers &) = delete;
+    ChipWorkers &operator=(const ChipWorkers &) = delete;
+
+    /**
+     * @brief Spawn the workers for the chips
+     * @param chips Chips to render, the first one is rendered by the caller
+     * @param count Count of chips
+     */
+    void start(fm_chip *const *chips, unsigned int count);
+
+    /**
+     * @brief Stop and join all workers
+     */
+    void stop();
+
+    /**
+     * @brief Render all chips and sum their outputs with the saturation
+     * @param buffer Output stereo frames
+     * @param length Count of frames
+     */
+    void generate(int *buffer, unsigned int length);
+
+    /**
+     * @brief Render all chips and sum their normalized outputs
+     * @param buffer Output stereo frames
+     * @param length Count of frames
+     */
+    void generate_float(float *buffer, unsigned int length);
+};
+
+#endif // CHIP_WORKERS_H
@@ -0,0 +1,430 @@
+//
+// Copyright(C) 2025-2026 Vitaliy Novichkov
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Process-wide store of GENMIDI banks shared by all synths.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <cstdio>
+#include "genmidi_bank.h"
+#include "../flushout.h"
+
+#if defined(_WIN32)
+#   include <windows.h>
+#   define GENMIDI_MAP_WIN32
+#elif defined(__DJGPP__) || defined(__WATCOMC__)
+#   include <sys/stat.h>
+#   define GENMIDI_MAP_NONE
+#else
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   define GENMIDI_MAP_POSIX
+#endif
+
+// DOS builds have no threads to protect the store from
+#if !defined(__DJGPP__) && !defined(__WATCOMC__)
+#   include <mutex>
+#   define GENMIDI_BANK_LOCK() std::lock_guard<std::mutex> lock(banks_mutex)
+static std::mutex banks_mutex;
+#else
+#   define GENMIDI_BANK_LOCK()
+#endif
+
+#define GENMIDI_BANK_SIZE \
+    (sizeof(genmidi_instr_t) * (GENMIDI_NUM_INSTRS + GENMIDI_NUM_PERCUSSION))
+
+#define WAD_HEADER_SIZE     12
+#define WAD_LUMPINFO_SIZE   16
+
+struct genmidi_bank_s
+{
+    // Key of the bank: path, modification time and size of the file
+    char *path;
+    unsigned long long mtime;
+    unsigned long long size;
+
+    // Count of synths using this bank
+    unsigned int refs;
+
+    // The whole file contents
+    const byte *data;
+#if defined(GENMIDI_MAP_WIN32)
+    HANDLE mapping;
+#endif
+
+    const genmidi_instr_t *instrs;
+
+    genmidi_bank_t *next;
+};
+
+static genmidi_bank_t *banks = NULL;
+
+static void BankError(const char *format, const char *path)
+{
+    s_fprintf(stderr, format, path);
+    flushout(stderr);
+}
+
+static unsigned int ReadLE32(const byte *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+#if defined(GENMIDI_MAP_WIN32)
+static bool PathToWide(const char *path, wchar_t *out)
+{
+    int len = (int)strlen(path);
+    int new_len;
+
+    if (len == 0)
+    {
+        return false;
+    }
+
+    new_len = MultiByteToWideChar(CP_UTF8, 0, path, len, out, MAX_PATH - 1);
+
+    if (new_len <= 0 || new_len >= MAX_PATH)
+    {
+        return false;
+    }
+
+    out[new_len] = L'\0';
+    return true;
+}
+#endif
+
+// Get the modification time and the size of the file.
+
+static bool StatFile(const char *path, unsigned long long *mtime, unsigned long long *size)
+{
+#if defined(GENMIDI_MAP_WIN32)
+    wchar_t wpath[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+
+    if (!PathToWide(path, wpath)
+     || !GetFileAttributesExW(wpath, GetFileExInfoStandard, &attr)
+     || (attr.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+    {
+        return false;
+    }
+
+    *mtime = ((unsigned long long)attr.ftLastWriteTime.dwHighDateTime << 32)
+           | attr.ftLastWriteTime.dwLowDateTime;
+    *size = ((unsigned long long)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+#else
+    struct stat st;
+
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return false;
+    }
+
+    *mtime = (unsigned long long)st.st_mtime;
+    *size = (unsigned long long)st.st_size;
+#endif
+
+    return true;
+}
+
+// Make the whole file contents available at bank->data.
+
+static bool MapFile(genmidi_bank_t *bank)
+{
+#if defined(GENMIDI_MAP_WIN32)
+    wchar_t wpath[MAX_PATH];
+    HANDLE file;
+
+    if (!PathToWide(bank->path, wpath))
+    {
+        return false;
+    }
+
+    file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    bank->mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+
+    if (bank->mapping == NULL)
+    {
+        return false;
+    }
+
+    bank->data = (const byte *) MapViewOfFile(bank->mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (bank->data == NULL)
+    {
+        CloseHandle(bank->mapping);
+        bank->mapping = NULL;
+        return false;
+    }
+
+    return true;
+
+#elif defined(GENMIDI_MAP_POSIX)
+    void *data;
+    int fd = open(bank->path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    data = mmap(NULL, (size_t)bank->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    bank->data = (const byte *) data;
+    return true;
+
+#else
+    byte *data;
+    size_t ret;
+    FILE *file = fopen(bank->path, "rb");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    data = (byte *) malloc((size_t)bank->size);
+
+    if (!data)
+    {
+        fclose(file);
+        return false;
+    }
+
+    ret = fread(data, 1, (size_t)bank->size, file);
+    fclose(file);
+
+    if (ret != bank->size)
+    {
+        free(data);
+        return false;
+    }
+
+    bank->data = data;
+    return true;
+#endif
+}
+
+static void UnmapFile(genmidi_bank_t *bank)
+{
+    if (!bank->data)
+    {
+        return;
+    }
+
+#if defined(GENMIDI_MAP_WIN32)
+    UnmapViewOfFile(bank->data);
+    CloseHandle(bank->mapping);
+#elif defined(GENMIDI_MAP_POSIX)
+    munmap((void *) bank->data, (size_t)bank->size);
+#else
+    free((void *) bank->data);
+#endif
+
+    bank->data = NULL;
+}
+
+// Find the GENMIDI lump in the WAD file.  Like Doom does, the last
+// lump with this name is used.
+
+static bool FindWadLump(genmidi_bank_t *bank, unsigned long long *offset, unsigned long long *size)
+{
+    const byte *info;
+    unsigned long long numlumps, infotableofs;
+    unsigned long long filepos, filelen;
+
+    numlumps = ReadLE32(bank->data + 4);
+    infotableofs = ReadLE32(bank->data + 8);
+
+    if (infotableofs > bank->size
+     || numlumps > (bank->size - infotableofs) / WAD_LUMPINFO_SIZE)
+    {
+        return false;
+    }
+
+    while (numlumps > 0)
+    {
+        --numlumps;
+        info = bank->data + infotableofs + numlumps * WAD_LUMPINFO_SIZE;
+
+        if (strncmp((const char *) info + 8, "GENMIDI", 8) != 0)
+        {
+            continue;
+        }
+
+        filepos = ReadLE32(info);
+        filelen = ReadLE32(info + 4);
+
+        if (filepos > bank->size || filelen > bank->size - filepos)
+        {
+            return false;
+        }
+
+        *offset = filepos;
+        *size = filelen;
+        return true;
+    }
+
+    return false;
+}
+
+// Locate and validate the instruments table in the file.
+
+static bool FindInstruments(genmidi_bank_t *bank)
+{
+    unsigned long long offset = 0;
+    unsigned long long size = bank->size;
+
+    if (bank->size >= WAD_HEADER_SIZE
+     && (memcmp(bank->data, "IWAD", 4) == 0 || memcmp(bank->data, "PWAD", 4) == 0))
+    {
+        if (!FindWadLump(bank, &offset, &size))
+        {
+            BankError(" - SYNTH ERROR: WAD file %s has no valid GENMIDI lump\n", bank->path);
+            return false;
+        }
+    }
+
+    if (size < GENMIDI_BANK_SIZE + strlen(GENMIDI_HEADER))
+    {
+        BankError(" - SYNTH ERROR: Bank file %s is smaller than needed\n", bank->path);
+        return false;
+    }
+
+    if (memcmp(bank->data + offset, GENMIDI_HEADER, strlen(GENMIDI_HEADER)) != 0)
+    {
+        BankError(" - SYNTH ERROR: Bank file %s contains invalid signature\n", bank->path);
+        return false;
+    }
+
+    bank->instrs = (const genmidi_instr_t *) (bank->data + offset + strlen(GENMIDI_HEADER));
+
+    return true;
+}
+
+static void FreeBank(genmidi_bank_t *bank)
+{
+    UnmapFile(bank);
+    free(bank->path);
+    free(bank);
+}
+
+genmidi_bank_t *GENMIDI_AcquireBank(const char *path)
+{
+    genmidi_bank_t *bank;
+    unsigned long long mtime, size;
+    GENMIDI_BANK_LOCK();
+
+    if (!StatFile(path, &mtime, &size))
+    {
+        BankError(" - SYNTH ERROR: Failed to open bank %s\n", path);
+        return NULL;
+    }
+
+    for (bank = banks; bank != NULL; bank = bank->next)
+    {
+        if (bank->mtime == mtime && bank->size == size && strcmp(bank->path, path) == 0)
+        {
+            ++bank->refs;
+            return bank;
+        }
+    }
+
+    if (size < GENMIDI_BANK_SIZE + strlen(GENMIDI_HEADER) || size != (size_t)size)
+    {
+        BankError(" - SYNTH ERROR: Bank file %s is smaller than needed\n", path);
+        return NULL;
+    }
+
+    bank = (genmidi_bank_t *) calloc(1, sizeof(genmidi_bank_t));
+
+    if (bank)
+    {
+        bank->path = (char *) malloc(strlen(path) + 1);
+    }
+
+    if (!bank || !bank->path)
+    {
+        s_fprintf(stderr, " - SYNTH ERROR: Out of memory\n");
+        flushout(stderr);
+        free(bank);
+        return NULL;
+    }
+
+    strcpy(bank->path, path);
+    bank->mtime = mtime;
+    bank->size = size;
+
+    if (!MapFile(bank))
+    {
+        BankError(" - SYNTH ERROR: Failed to load bank %s\n", path);
+        FreeBank(bank);
+        return NULL;
+    }
+
+    if (!FindInstruments(bank))
+    {
+        FreeBank(bank);
+        return NULL;
+    }
+
+    bank->refs = 1;
+    bank->next = banks;
+    banks = bank;
+
+    return bank;
+}
+
+void GENMIDI_ReleaseBank(genmidi_bank_t *bank)
+{
+    genmidi_bank_t **link;
+    GENMIDI_BANK_LOCK();
+
+    if (!bank || --bank->refs > 0)
+    {
+        return;
+    }
+
+    for (link = &banks; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == bank)
+        {
+            *link = bank->next;
+            break;
+        }
+    }
+
+    FreeBank(bank);
+}
+
+const genmidi_instr_t *GENMIDI_BankInstruments(const genmidi_bank_t *bank)
+{
+    return bank->instrs;
+}
@@ -0,0 +1,40 @@
+//
+// Copyright(C) 2025-2026 Vitaliy Novichkov
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Process-wide store of GENMIDI banks shared by all synths.
+//
+
+#ifndef GENMIDI_BANK_H
+#define GENMIDI_BANK_H
+
+#include "i_oplmusic.h"
+
+// Open the bank from the .op2 file or from the GENMIDI lump of the WAD
+// file.  The bank already opened with the same path and modification
+// time is shared, otherwise the file gets memory-mapped and validated.
+// Returns NULL on failure (the reason is printed to stderr).
+
+genmidi_bank_t *GENMIDI_AcquireBank(const char *path);
+
+// Drop the reference to the bank, the file gets unmapped once
+// no synth uses it anymore.
+
+void GENMIDI_ReleaseBank(genmidi_bank_t *bank);
+
+// Read-only instruments of the bank: GENMIDI_NUM_INSTRS of main
+// instruments followed by GENMIDI_NUM_PERCUSSION of percussions.
+
+const genmidi_instr_t *GENMIDI_BankInstruments(const genmidi_bank_t *bank);
+
+#endif // GENMIDI_BANK_H
@@ -20,60 +20,251 @@
 #include <string.h>
 #include <cstdio>
 #include "i_oplmusic.h"
-#include "../flushout.h"
-#ifdef _WIN32
-#   include <windows.h>
+#include "genmidi_bank.h"
+#ifndef HW_DOS_BUILD
+#   include "chip_workers.h"
+#   include "opl_log.h"
 #endif
+#include "../flushout.h"
+
+// Operators used by the different voices.
+
+static const int voice_operators[2][OPL_NUM_VOICES] = {
+    { 0x00, 0x01, 0x02, 0x08, 0x09, 0x0a, 0x10, 0x11, 0x12 },
+    { 0x03, 0x04, 0x05, 0x0b, 0x0c, 0x0d, 0x13, 0x14, 0x15 }
+};
+
+// Frequency values to use for each note.
+
+static const unsigned short frequency_curve[] = {
+
+    0x133, 0x133, 0x134, 0x134, 0x135, 0x136, 0x136, 0x137,   // -1
+    0x137, 0x138, 0x138, 0x139, 0x139, 0x13a, 0x13b, 0x13b,
+    0x13c, 0x13c, 0x13d, 0x13d, 0x13e, 0x13f, 0x13f, 0x140,
+    0x140, 0x141, 0x142, 0x142, 0x143, 0x143, 0x144, 0x144,
+
+    0x145, 0x146, 0x146, 0x147, 0x147, 0x148, 0x149, 0x149,   // -2
+    0x14a, 0x14a, 0x14b, 0x14c, 0x14c, 0x14d, 0x14d, 0x14e,
+    0x14f, 0x14f, 0x150, 0x150, 0x151, 0x152, 0x152, 0x153,
+    0x153, 0x154, 0x155, 0x155, 0x156, 0x157, 0x157, 0x158,
+
+    // These are used for the first seven MIDI note values:
+
+    0x158, 0x159, 0x15a, 0x15a, 0x15b, 0x15b, 0x15c, 0x15d,   // 0
+    0x15d, 0x15e, 0x15f, 0x15f, 0x160, 0x161, 0x161, 0x162,
+    0x162, 0x163, 0x164, 0x164, 0x165, 0x166, 0x166, 0x167,
+    0x168, 0x168, 0x169, 0x16a, 0x16a, 0x16b, 0x16c, 0x16c,
+
+    0x16d, 0x16e, 0x16e, 0x16f, 0x170, 0x170, 0x171, 0x172,   // 1
+    0x172, 0x173, 0x174, 0x174, 0x175, 0x176, 0x176, 0x177,
+    0x178, 0x178, 0x179, 0x17a, 0x17a, 0x17b, 0x17c, 0x17c,
+    0x17d, 0x17e, 0x17e, 0x17f, 0x180, 0x181, 0x181, 0x182,
+
+    0x183, 0x183, 0x184, 0x185, 0x185, 0x186, 0x187, 0x188,   // 2
+    0x188, 0x189, 0x18a, 0x18a, 0x18b, 0x18c, 0x18d, 0x18d,
+    0x18e, 0x18f, 0x18f, 0x190, 0x191, 0x192, 0x192, 0x193,
+    0x194, 0x194, 0x195, 0x196, 0x197, 0x197, 0x198, 0x199,
+
+    0x19a, 0x19a, 0x19b, 0x19c, 0x19d, 0x19d, 0x19e, 0x19f,   // 3
+    0x1a0, 0x1a0, 0x1a1, 0x1a2, 0x1a3, 0x1a3, 0x1a4, 0x1a5,
+    0x1a6, 0x1a6, 0x1a7, 0x1a8, 0x1a9, 0x1a9, 0x1aa, 0x1ab,
+    0x1ac, 0x1ad, 0x1ad, 0x1ae, 0x1af, 0x1b0, 0x1b0, 0x1b1,
+
+    0x1b2, 0x1b3, 0x1b4, 0x1b4, 0x1b5, 0x1b6, 0x1b7, 0x1b8,   // 4
+    0x1b8, 0x1b9, 0x1ba, 0x1bb, 0x1bc, 0x1bc, 0x1bd, 0x1be,
+    0x1bf, 0x1c0, 0x1c0, 0x1c1, 0x1c2, 0x1c3, 0x1c4, 0x1c4,
+    0x1c5, 0x1c6, 0x1c7, 0x1c8, 0x1c9, 0x1c9, 0x1ca, 0x1cb,
+
+    0x1cc, 0x1cd, 0x1ce, 0x1ce, 0x1cf, 0x1d0, 0x1d1, 0x1d2,   // 5
+    0x1d3, 0x1d3, 0x1d4, 0x1d5, 0x1d6, 0x1d7, 0x1d8, 0x1d8,
+    0x1d9, 0x1da, 0x1db, 0x1dc, 0x1dd, 0x1de, 0x1de, 0x1df,
+    0x1e0, 0x1e1, 0x1e2, 0x1e3, 0x1e4, 0x1e5, 0x1e5, 0x1e6,
+
+    0x1e7, 0x1e8, 0x1e9, 0x1ea, 0x1eb, 0x1ec, 0x1ed, 0x1ed,   // 6
+    0x1ee, 0x1ef, 0x1f0, 0x1f1, 0x1f2, 0x1f3, 0x1f4, 0x1f5,
+    0x1f6, 0x1f6, 0x1f7, 0x1f8, 0x1f9, 0x1fa, 0x1fb, 0x1fc,
+    0x1fd, 0x1fe, 0x1ff, 0x200, 0x201, 0x201, 0x202, 0x203,
+
+    // First note of looped range used for all octaves:
+
+    0x204, 0x205, 0x206, 0x207, 0x208, 0x209, 0x20a, 0x20b,   // 7
+    0x20c, 0x20d, 0x20e, 0x20f, 0x210, 0x210, 0x211, 0x212,
+    0x213, 0x214, 0x215, 0x216, 0x217, 0x218, 0x219, 0x21a,
+    0x21b, 0x21c, 0x21d, 0x21e, 0x21f, 0x220, 0x221, 0x222,
+
+    0x223, 0x224, 0x225, 0x226, 0x227, 0x228, 0x229, 0x22a,   // 8
+    0x22b, 0x22c, 0x22d, 0x22e, 0x22f, 0x230, 0x231, 0x232,
+    0x233, 0x234, 0x235, 0x236, 0x237, 0x238, 0x239, 0x23a,
+    0x23b, 0x23c, 0x23d, 0x23e, 0x23f, 0x240, 0x241, 0x242,
+
+    0x244, 0x245, 0x246, 0x247, 0x248, 0x249, 0x24a, 0x24b,   // 9
+    0x24c, 0x24d, 0x24e, 0x24f, 0x250, 0x251, 0x252, 0x253,
+    0x254, 0x256, 0x257, 0x258, 0x259, 0x25a, 0x25b, 0x25c,
+    0x25d, 0x25e, 0x25f, 0x260, 0x262, 0x263, 0x264, 0x265,
+
+    0x266, 0x267, 0x268, 0x269, 0x26a, 0x26c, 0x26d, 0x26e,   // 10
+    0x26f, 0x270, 0x271, 0x272, 0x273, 0x275, 0x276, 0x277,
+    0x278, 0x279, 0x27a, 0x27b, 0x27d, 0x27e, 0x27f, 0x280,
+    0x281, 0x282, 0x284, 0x285, 0x286, 0x287, 0x288, 0x289,
+
+    0x28b, 0x28c, 0x28d, 0x28e, 0x28f, 0x290, 0x292, 0x293,   // 11
+    0x294, 0x295, 0x296, 0x298, 0x299, 0x29a, 0x29b, 0x29c,
+    0x29e, 0x29f, 0x2a0, 0x2a1, 0x2a2, 0x2a4, 0x2a5, 0x2a6,
+    0x2a7, 0x2a9, 0x2aa, 0x2ab, 0x2ac, 0x2ae, 0x2af, 0x2b0,
+
+    0x2b1, 0x2b2, 0x2b4, 0x2b5, 0x2b6, 0x2b7, 0x2b9, 0x2ba,   // 12
+    0x2bb, 0x2bd, 0x2be, 0x2bf, 0x2c0, 0x2c2, 0x2c3, 0x2c4,
+    0x2c5, 0x2c7, 0x2c8, 0x2c9, 0x2cb, 0x2cc, 0x2cd, 0x2ce,
+    0x2d0, 0x2d1, 0x2d2, 0x2d4, 0x2d5, 0x2d6, 0x2d8, 0x2d9,
+
+    0x2da, 0x2dc, 0x2dd, 0x2de, 0x2e0, 0x2e1, 0x2e2, 0x2e4,   // 13
+    0x2e5, 0x2e6, 0x2e8, 0x2e9, 0x2ea, 0x2ec, 0x2ed, 0x2ee,
+    0x2f0, 0x2f1, 0x2f2, 0x2f4, 0x2f5, 0x2f6, 0x2f8, 0x2f9,
+    0x2fb, 0x2fc, 0x2fd, 0x2ff, 0x300, 0x302, 0x303, 0x304,
+
+    0x306, 0x307, 0x309, 0x30a, 0x30b, 0x30d, 0x30e, 0x310,   // 14
+    0x311, 0x312, 0x314, 0x315, 0x317, 0x318, 0x31a, 0x31b,
+    0x31c, 0x31e, 0x31f, 0x321, 0x322, 0x324, 0x325, 0x327,
+    0x328, 0x329, 0x32b, 0x32c, 0x32e, 0x32f, 0x331, 0x332,
+
+    0x334, 0x335, 0x337, 0x338, 0x33a, 0x33b, 0x33d, 0x33e,   // 15
+    0x340, 0x341, 0x343, 0x344, 0x346, 0x347, 0x349, 0x34a,
+    0x34c, 0x34d, 0x34f, 0x350, 0x352, 0x353, 0x355, 0x357,
+    0x358, 0x35a, 0x35b, 0x35d, 0x35e, 0x360, 0x361, 0x363,
+
+    0x365, 0x366, 0x368, 0x369, 0x36b, 0x36c, 0x36e, 0x370,   // 16
+    0x371, 0x373, 0x374, 0x376, 0x378, 0x379, 0x37b, 0x37c,
+    0x37e, 0x380, 0x381, 0x383, 0x384, 0x386, 0x388, 0x389,
+    0x38b, 0x38d, 0x38e, 0x390, 0x392, 0x393, 0x395, 0x397,
+
+    0x398, 0x39a, 0x39c, 0x39d, 0x39f, 0x3a1, 0x3a2, 0x3a4,   // 17
+    0x3a6, 0x3a7, 0x3a9, 0x3ab, 0x3ac, 0x3ae, 0x3b0, 0x3b1,
+    0x3b3, 0x3b5, 0x3b7, 0x3b8, 0x3ba, 0x3bc, 0x3bd, 0x3bf,
+    0x3c1, 0x3c3, 0x3c4, 0x3c6, 0x3c8, 0x3ca, 0x3cb, 0x3cd,
+
+    // The last note has an incomplete range, and loops round back to
+    // the start.  Note that the last value is actually a buffer overrun
+    // and does not fit with the other values.
+
+    0x3cf, 0x3d1, 0x3d2, 0x3d4, 0x3d6, 0x3d8, 0x3da, 0x3db,   // 18
+    0x3dd, 0x3df, 0x3e1, 0x3e3, 0x3e4, 0x3e6, 0x3e8, 0x3ea,
+    0x3ec, 0x3ed, 0x3ef, 0x3f1, 0x3f3, 0x3f5, 0x3f6, 0x3f8,
+    0x3fa, 0x3fc, 0x3fe, 0x36c,
+};
+
+// Mapping from MIDI volume level to OPL level value.
+
+static const unsigned int volume_mapping_table[] = {
+    0, 1, 3, 5, 6, 8, 10, 11,
+    13, 14, 16, 17, 19, 20, 22, 23,
+    25, 26, 27, 29, 30, 32, 33, 34,
+    36, 37, 39, 41, 43, 45, 47, 49,
+    50, 52, 54, 55, 57, 59, 60, 61,
+    63, 64, 66, 67, 68, 69, 71, 72,
+    73, 74, 75, 76, 77, 79, 80, 81,
+    82, 83, 84, 84, 85, 86, 87, 88,
+    89, 90, 91, 92, 92, 93, 94, 95,
+    96, 96, 97, 98, 99, 99, 100, 101,
+    101, 102, 103, 103, 104, 105, 105, 106,
+    107, 107, 108, 109, 109, 110, 110, 111,
+    112, 112, 113, 113, 114, 114, 115, 115,
+    116, 117, 117, 118, 118, 119, 119, 120,
+    120, 121, 121, 122, 122, 123, 123, 123,
+    124, 124, 125, 125, 126, 126, 127, 127
+};
+
+static const unsigned int channel_map_table[MIDI_CHANNELS_PER_TRACK] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 15, 9, 10, 11, 12, 13, 14
+};
 
 #if defined(__DJGPP__)
 void DoomOPL_lockCodeBegin()
 {}
 #endif
 
-static FILE* i_fopen(const char*filename, const char*mode) {
-#ifdef _WIN32
-    int new_Len1 = 0;
-    int new_Len2 = 0;
-    int fn_len_s = strlen(filename);
-    int m_len_s  = strlen(mode);
-    if (fn_len_s == 0)
+DoomOPL::DoomOPL() :
+    midisynth()
+{}
+
+void DoomOPL::OPL_WriteRegister(unsigned int reg, unsigned char data) {
+    fm_chip *chip = opl_chips[reg >> OPL_CHIP_SHIFT];
+
+    reg &= (1 << OPL_CHIP_SHIFT) - 1;
+
+    if (opl_write_offset != 0)
     {
-        return NULL;
+        chip->fm_writereg_at(opl_write_offset, reg, data);
     }
-    if (m_len_s == 0)
+    else
     {
-        return NULL;
+        chip->fm_writereg(reg, data);
     }
-    wchar_t path[MAX_PATH];
-    wchar_t wmode[MAX_PATH];
-    new_Len1 = MultiByteToWideChar(CP_UTF8, 0, filename, fn_len_s, path, fn_len_s);
-    if (new_Len1 >= MAX_PATH)
+}
+
+// Write the raw register writes of the current tick into the chip.
+
+void DoomOPL::OPL_FlushRawWrites(void)
+{
+#ifndef HW_DOS_BUILD
+    unsigned int i;
+
+    for (i = 0; i < raw_writes_num; ++i)
     {
-        return NULL;
+        opl_chips[0]->fm_writereg(raw_writes[i][0], raw_writes[i][1]);
     }
-    path[new_Len1] = L'\0';
-    new_Len2 = MultiByteToWideChar(CP_UTF8, 0, mode, m_len_s, wmode, m_len_s);
-    if (new_Len2 >= MAX_PATH)
+
+    raw_writes_num = 0;
+#endif
+}
+
+// Silence the notes left by the raw OPL song and give the chip back
+// to the synth.
+
+void DoomOPL::OPL_StopRawMode(void)
+{
+    unsigned int r;
+
+    OPL_FlushRawWrites();
+
+    for (r = OPL_REGS_FREQ_2; r < OPL_REGS_FREQ_2 + OPL_NUM_VOICES; ++r)
     {
-        return NULL;
+        opl_chips[0]->fm_writereg(r, 0x00);
     }
-    wmode[new_Len2] = L'\0';
-    FILE *f = _wfopen(path, wmode);
-    return f;
-#else
-    return fopen(filename, mode);
-#endif
+
+    opl_chips[0]->fm_writereg(0xBD, 0x00);
+
+    if (opl_new)
+    {
+        opl_chips[0]->fm_writereg(OPL_REG_NEW_MODE, 0x01);
+    }
+
+    raw_mode = false;
 }
 
-DoomOPL::DoomOPL() :
-    midisynth()
-{}
+#ifndef HW_DOS_BUILD
+// Write the register log recorded so far into the file.
 
-void DoomOPL::OPL_WriteRegister(unsigned int reg, unsigned char data) {
-    opl->fm_writereg(reg, data);
+void DoomOPL::OPL_FinishCapture(void)
+{
+    if (!m_capture)
+    {
+        return;
+    }
+
+    if (m_capture->save(m_capturePath) && m_verbose)
+    {
+        s_fprintf(stdout, " - DEBUG: Register log saved into %s\n", m_capturePath);
+        flushout(stdout);
+    }
+
+    delete m_capture;
+    m_capture = nullptr;
 }
+#endif
+
+// Initialize the registers of one chip, given as the register number bits.
 
-void DoomOPL::OPL_InitRegisters(bool opl_new)
+void DoomOPL::OPL_InitRegisters(unsigned int chip, bool opl_new)
 {
     unsigned int r;
 
@@ -81,7 +272,7 @@ void DoomOPL::OPL_InitRegisters(bool opl_new)
 
     for (r = OPL_REGS_LEVEL; r <= OPL_REGS_LEVEL + OPL_NUM_OPERATORS; ++r)
     {
-        OPL_WriteRegister(r, 0x3f);
+        OPL_WriteRegister(chip | r, 0x3f);
     }
 
     // Initialize other registers
@@ -91,23 +282,23 @@ void DoomOPL::OPL_InitRegisters(bool opl_new)
 
     for (r = OPL_REGS_ATTACK; r <= OPL_REGS_WAVEFORM + OPL_NUM_OPERATORS; ++r)
     {
-        OPL_WriteRegister(r, 0x00);
+        OPL_WriteRegister(chip | r, 0x00);
     }
 
     // More registers ...
 
     for (r = 1; r < OPL_REGS_LEVEL; ++r)
     {
-        OPL_WriteRegister(r, 0x00);
+        OPL_WriteRegister(chip | r, 0x00);
     }
 
     if (opl_new)
     {
-        OPL_WriteRegister(OPL_REG_NEW_MODE, 0x01);
+        OPL_WriteRegister(chip | OPL_REG_NEW_MODE, 0x01);
         // Initialize level registers
         for (r = OPL_REGS_LEVEL; r <= OPL_REGS_LEVEL + OPL_NUM_OPERATORS; ++r)
         {
-            OPL_WriteRegister(r | 0x100, 0x3f);
+            OPL_WriteRegister(chip | r | 0x100, 0x3f);
         }
 
         // Initialize other registers
@@ -117,31 +308,31 @@ void DoomOPL::OPL_InitRegisters(bool opl_new)
 
         for (r = OPL_REGS_ATTACK; r <= OPL_REGS_WAVEFORM + OPL_NUM_OPERATORS; ++r)
         {
-            OPL_WriteRegister(r | 0x100, 0x00);
+            OPL_WriteRegister(chip | r | 0x100, 0x00);
         }
 
         // More registers ...
 
         for (r = 1; r < OPL_REGS_LEVEL; ++r)
         {
-            OPL_WriteRegister(r | 0x100, 0x00);
+            OPL_WriteRegister(chip | r | 0x100, 0x00);
         }
     }
 
     // Re-initialize the low registers:
 
     // Reset both timers and enable interrupts:
-    OPL_WriteRegister(OPL_REG_TIMER_CTRL, 0x60);
-    OPL_WriteRegister(OPL_REG_TIMER_CTRL, 0x80);
+    OPL_WriteRegister(chip | OPL_REG_TIMER_CTRL, 0x60);
+    OPL_WriteRegister(chip | OPL_REG_TIMER_CTRL, 0x80);
 
     // "Allow FM chips to control the waveform of each operator":
-    OPL_WriteRegister(OPL_REG_WAVEFORM_ENABLE, 0x20);
+    OPL_WriteRegister(chip | OPL_REG_WAVEFORM_ENABLE, 0x20);
 
     // Keyboard split point on (?)
-    OPL_WriteRegister(OPL_REG_FM_MODE, 0x40);
+    OPL_WriteRegister(chip | OPL_REG_FM_MODE, 0x40);
     if (opl_new)
     {
-        OPL_WriteRegister(OPL_REG_NEW_MODE, 0x01);
+        OPL_WriteRegister(chip | OPL_REG_NEW_MODE, 0x01);
     }
 }
 
@@ -149,114 +340,212 @@ void DoomOPL::OPL_InitRegisters(bool opl_new)
 
 bool DoomOPL::LoadInstrumentTable(void)
 {
-    size_t size, ret;
-    FILE *file = i_fopen(m_bankPath, "rb");
+    genmidi_bank_t *bank = GENMIDI_AcquireBank(m_bankPath);
 
-    if(!file)
+    if (!bank)
     {
-        s_fprintf(stderr, " - SYNTH ERROR: Failed to open bank %s\n", m_bankPath);
-        flushout(stderr);
         return false;
     }
 
-    fseek(file, 0, SEEK_END);
-    size = (size_t)ftell(file);
-    fseek(file, 0, SEEK_SET);
+    main_instrs = GENMIDI_BankInstruments(bank);
+    percussion_instrs = main_instrs + GENMIDI_NUM_INSTRS;
+
+    // Same bank as before, its programs are already compiled.
 
-    if(m_lump)
+    if (bank == m_bank)
     {
-        free(m_lump);
-        m_lump = NULL;
+        GENMIDI_ReleaseBank(bank);
+        return true;
     }
 
-    if(size < (sizeof(genmidi_instr_t) * (GENMIDI_NUM_INSTRS + GENMIDI_NUM_PERCUSSION)) + strlen(GENMIDI_HEADER))
+    if (m_bank)
     {
-        s_fprintf(stderr, " - SYNTH ERROR: Bank file %s is smaller than needed\n", m_bankPath);
-        flushout(stderr);
-        fclose(file);
-        return false;
+        GENMIDI_ReleaseBank(m_bank);
     }
 
-    m_lump = (byte*)malloc(size);
+    m_bank = bank;
 
-    if(!m_lump)
+    CompileInstruments();
+
+    return true;
+}
+
+// Intrusive lists of voices.  A removed voice keeps its links, so a walk
+// over the list can continue from it to the voices following it.
+
+static void VoiceListPushBack(opl_voice_list_t *list, opl_voice_t *voice)
+{
+    voice->prev = list->tail;
+    voice->next = NULL;
+
+    if (list->tail)
     {
-        s_fprintf(stderr, " - SYNTH ERROR: Out of memory\n");
-        flushout(stderr);
-        fclose(file);
-        return false;
+        list->tail->next = voice;
+    }
+    else
+    {
+        list->head = voice;
     }
 
-    ret = fread(m_lump, 1, size, file);
-    fclose(file);
+    list->tail = voice;
+}
 
-    if(ret != size)
+static void VoiceListRemove(opl_voice_list_t *list, opl_voice_t *voice)
+{
+    if (voice->prev)
     {
-        s_fprintf(stderr, " - SYNTH ERROR: Failed to load bank %s\n", m_bankPath);
-        flushout(stderr);
-        return false;
+        voice->prev->next = voice->next;
+    }
+    else
+    {
+        list->head = voice->next;
     }
 
-    if(memcmp(m_lump, GENMIDI_HEADER, 8) != 0)
+    if (voice->next)
     {
-        s_fprintf(stderr, " - SYNTH ERROR: Bank file %s contains invalid signature\n", m_bankPath);
-        flushout(stderr);
-        return false;
+        voice->next->prev = voice->prev;
+    }
+    else
+    {
+        list->tail = voice->prev;
     }
+}
 
-    main_instrs = (genmidi_instr_t *) (m_lump + strlen(GENMIDI_HEADER));
-    percussion_instrs = main_instrs + GENMIDI_NUM_INSTRS;
+static void ChannelListPushBack(opl_voice_list_t *list, opl_voice_t *voice)
+{
+    voice->chan_prev = list->tail;
+    voice->chan_next = NULL;
 
-    return true;
+    if (list->tail)
+    {
+        list->tail->chan_next = voice;
+    }
+    else
+    {
+        list->head = voice;
+    }
+
+    list->tail = voice;
+}
+
+static void ChannelListRemove(opl_voice_list_t *list, opl_voice_t *voice)
+{
+    if (voice->chan_prev)
+    {
+        voice->chan_prev->chan_next = voice->chan_next;
+    }
+    else
+    {
+        list->head = voice->chan_next;
+    }
+
+    if (voice->chan_next)
+    {
+        voice->chan_next->chan_prev = voice->chan_prev;
+    }
+    else
+    {
+        list->tail = voice->chan_prev;
+    }
 }
 
 // Release a voice back to the freelist.
 
-void DoomOPL::ReleaseVoice(unsigned int id)
+void DoomOPL::ReleaseVoice(opl_voice_t *voice)
 {
-    opl_voice_t *voice;
-    unsigned int i;
+    opl_voice_t *next;
+    unsigned int ch;
     bool doublev;
 
     // Doom 2 1.666 OPL crash emulation.
-    if (id >= voice_alloced_num)
+    if (voice == NULL)
     {
         voice_alloced_num = 0;
         voice_free_num = 0;
+        memset(&voice_alloced_list, 0, sizeof(voice_alloced_list));
+        memset(&voice_free_list, 0, sizeof(voice_free_list));
+        memset(channel_voices, 0, sizeof(channel_voices));
+        channel_voices_mask = 0;
         return;
     }
-    voice = voice_alloced_list[id];
 
     VoiceKeyOff(voice);
 
+    // Remove from alloced list.
+
+    ch = voice->channel - channels;
+    next = voice->next;
+
+    VoiceListRemove(&voice_alloced_list, voice);
+    voice_alloced_num--;
+
+    ChannelListRemove(&channel_voices[ch], voice);
+
+    if (channel_voices[ch].head == NULL)
+    {
+        channel_voices_mask &= ~(1u << ch);
+    }
+
     voice->channel = NULL;
     voice->note = 0;
 
     doublev = voice->current_instr_voice != 0;
 
-    // Remove from alloced list.
+    // Search to the end of the freelist (This is how Doom behaves!)
 
-    voice_alloced_num--;
+    VoiceListPushBack(&voice_free_list, voice);
+    voice_free_num++;
+
+    // Doom releases the voice which took the place of this one in the
+    // alloced list, that's not necessarily the pair of this voice.
+    // If this voice was the last one, the driver crashes.
 
-    for (i = id; i < voice_alloced_num; i++)
+    if (doublev && opl_drv_ver < opl_doom_1_9)
     {
-        voice_alloced_list[i] = voice_alloced_list[i + 1];
+        ReleaseVoice(next);
     }
+}
 
-    // Search to the end of the freelist (This is how Doom behaves!)
+// Release voices of the channel playing the key (or all of them)
+// in the order of the alloced list.
 
-    voice_free_list[voice_free_num++] = voice;
+void DoomOPL::ReleaseChannelVoices(opl_channel_data_t *channel, bool any_key, unsigned int key)
+{
+    opl_voice_t *voice;
 
-    if (doublev && opl_drv_ver < opl_doom_1_9)
+    voice = channel_voices[channel - channels].head;
+
+    while (voice != NULL)
     {
-        ReleaseVoice(id);
+        if (any_key || voice->key == key)
+        {
+            // Finished with this voice now.
+
+            ReleaseVoice(voice);
+
+            if (voice_alloced_num == 0)
+            {
+                break;
+            }
+
+            // Skip voices released together with this one.
+
+            do
+            {
+                voice = voice->chan_next;
+            } while (voice != NULL && voice->channel == NULL);
+
+            continue;
+        }
+
+        voice = voice->chan_next;
     }
 }
 
-// Load data to the specified operator
+// Compile register writes of the operator into the program
 
-void DoomOPL::LoadOperatorData(int slot, genmidi_op_t *data,
-                             bool max_level, unsigned int *volume)
+static opl_reg_write_t *CompileOperatorData(opl_reg_write_t *out, byte modulator,
+                                            const genmidi_op_t *data, bool max_level, byte *volume)
 {
     int level;
 
@@ -276,21 +565,68 @@ void DoomOPL::LoadOperatorData(int slot, genmidi_op_t *data,
 
     *volume = level;
 
-    OPL_WriteRegister(OPL_REGS_LEVEL + slot, level);
-    OPL_WriteRegister(OPL_REGS_TREMOLO + slot, data->tremolo);
-    OPL_WriteRegister(OPL_REGS_ATTACK + slot, data->attack);
-    OPL_WriteRegister(OPL_REGS_SUSTAIN + slot, data->sustain);
-    OPL_WriteRegister(OPL_REGS_WAVEFORM + slot, data->waveform);
+    out[0].reg = OPL_REGS_LEVEL | modulator;
+    out[0].value = level;
+    out[1].reg = OPL_REGS_TREMOLO | modulator;
+    out[1].value = data->tremolo;
+    out[2].reg = OPL_REGS_ATTACK | modulator;
+    out[2].value = data->attack;
+    out[3].reg = OPL_REGS_SUSTAIN | modulator;
+    out[3].value = data->sustain;
+    out[4].reg = OPL_REGS_WAVEFORM | modulator;
+    out[4].value = data->waveform;
+
+    return out + 5;
+}
+
+// Compile the programs of all voices of all instruments of the loaded bank
+
+void DoomOPL::CompileInstruments(void)
+{
+    unsigned int i, v;
+    const genmidi_voice_t *data;
+    opl_instr_program_t *program;
+    opl_reg_write_t *out;
+    bool modulating;
+
+    for (i = 0; i < GENMIDI_NUM_INSTRS + GENMIDI_NUM_PERCUSSION; ++i)
+    {
+        for (v = 0; v < 2; ++v)
+        {
+            data = &main_instrs[i].voices[v];
+            program = &instr_programs[i * 2 + v];
+
+            // Are we usind modulated feedback mode?
+
+            modulating = (data->feedback & 0x01) == 0;
+
+            // Doom loads the second operator first, then the first.
+            // The carrier is set to minimum volume until the voice volume
+            // is set in SetVoiceVolume (below).  If we are not using
+            // modulating mode, we must set both to minimum volume.
+
+            out = CompileOperatorData(program->regs, 0, &data->carrier, true, &program->car_volume);
+            CompileOperatorData(out, 1, &data->modulator, !modulating, &program->mod_volume);
+
+            program->feedback = data->feedback;
+
+            // Calculate voice priority.
+
+            program->priority = 0x0f - (data->carrier.attack >> 4)
+                              + 0x0f - (data->carrier.sustain & 0x0f);
+        }
+    }
 }
 
 // Set the instrument for a particular voice.
 
 void DoomOPL::SetVoiceInstrument(opl_voice_t *voice,
-                               genmidi_instr_t *instr,
+                               const genmidi_instr_t *instr,
                                unsigned int instr_voice)
 {
-    genmidi_voice_t *data;
-    unsigned int modulating;
+    opl_instr_program_t *program;
+    opl_reg_write_t *w, *end;
+    int ops[2];
 
     // Instrument already set for this channel?
 
@@ -303,36 +639,34 @@ void DoomOPL::SetVoiceInstrument(opl_voice_t *voice,
     voice->current_instr = instr;
     voice->current_instr_voice = instr_voice;
 
-    data = &instr->voices[instr_voice];
+    program = &instr_programs[(instr - main_instrs) * 2 + instr_voice];
 
-    // Are we usind modulated feedback mode?
+    // Replay the compiled operator writes
 
-    modulating = (data->feedback & 0x01) == 0;
+    ops[0] = voice->op2 | voice->array;
+    ops[1] = voice->op1 | voice->array;
 
-    // Doom loads the second operator first, then the first.
-    // The carrier is set to minimum volume until the voice volume
-    // is set in SetVoiceVolume (below).  If we are not using
-    // modulating mode, we must set both to minimum volume.
+    for (w = program->regs, end = w + OPL_INSTR_PROGRAM_LEN; w != end; ++w)
+    {
+        OPL_WriteRegister((w->reg & 0xfe) + ops[w->reg & 0x01], w->value);
+    }
 
-    LoadOperatorData(voice->op2 | voice->array, &data->carrier, true, &voice->car_volume);
-    LoadOperatorData(voice->op1 | voice->array, &data->modulator, !modulating, &voice->mod_volume);
+    voice->car_volume = program->car_volume;
+    voice->mod_volume = program->mod_volume;
 
     // Set feedback register that control the connection between the
     // two operators.  Turn on bits in the upper nybble; I think this
     // is for OPL3, where it turns on channel A/B.
 
     OPL_WriteRegister((OPL_REGS_FEEDBACK + voice->index) | voice->array,
-                      data->feedback | voice->reg_pan);
-
-    // Calculate voice priority.
+                      program->feedback | voice->reg_pan);
 
-    voice->priority = 0x0f - (data->carrier.attack >> 4)
-                    + 0x0f - (data->carrier.sustain & 0x0f);
+    voice->priority = program->priority;
 }
 
 void DoomOPL::SetVoiceVolume(opl_voice_t *voice, unsigned int volume)
 {
-    genmidi_voice_t *opl_voice;
+    const genmidi_voice_t *opl_voice;
     unsigned int midi_volume;
     unsigned int full_volume;
     unsigned int car_volume;
@@ -384,7 +718,7 @@ void DoomOPL::SetVoiceVolume(opl_voice_t *voice, unsigned int volume)
 
 void DoomOPL::SetVoicePan(opl_voice_t *voice, unsigned int pan)
 {
-    genmidi_voice_t *opl_voice;
+    const genmidi_voice_t *opl_voice;
 
     voice->reg_pan = pan;
     opl_voice = &voice->current_instr->voices[voice->current_instr_voice];
@@ -398,21 +732,31 @@ void DoomOPL::SetVoicePan(opl_voice_t *voice, unsigned int pan)
 void DoomOPL::InitVoices(void)
 {
     unsigned int i;
+    unsigned int chip, chip_voice;
 
     voice_free_num = opl_voices;
     voice_alloced_num = 0;
 
-    // Initialize each voice.
+    memset(&voice_alloced_list, 0, sizeof(voice_alloced_list));
+    memset(&voice_free_list, 0, sizeof(voice_free_list));
+    memset(channel_voices, 0, sizeof(channel_voices));
+    channel_voices_mask = 0;
+
+    // Initialize each voice.  In the multi-chip mode the voices of
+    // chips are interleaved so the load is spread between them.
 
     for (i = 0; i < opl_voices; ++i)
     {
-        voices[i].index = i % OPL_NUM_VOICES;
-        voices[i].op1 = voice_operators[0][i % OPL_NUM_VOICES];
-        voices[i].op2 = voice_operators[1][i % OPL_NUM_VOICES];
-        voices[i].array = (i / OPL_NUM_VOICES) << 8;
+        chip = i % opl_chips_num;
+        chip_voice = i / opl_chips_num;
+
+        voices[i].index = chip_voice % OPL_NUM_VOICES;
+        voices[i].op1 = voice_operators[0][chip_voice % OPL_NUM_VOICES];
+        voices[i].op2 = voice_operators[1][chip_voice % OPL_NUM_VOICES];
+        voices[i].array = ((chip_voice / OPL_NUM_VOICES) << 8) | (chip << OPL_CHIP_SHIFT);
         voices[i].current_instr = NULL;
 
-        voice_free_list[i] = &voices[i];
+        VoiceListPushBack(&voice_free_list, &voices[i]);
     }
 }
 
@@ -433,7 +777,6 @@ opl_channel_data_t *DoomOPL::TrackChannelForEvent(unsigned char channel_num)
 void DoomOPL::KeyOffEvent(unsigned char channel_num, unsigned char key)
 {
     opl_channel_data_t *channel;
-    unsigned int i;
 
 /*
     printf("note off: channel %i, %i, %i\n",
@@ -447,18 +790,7 @@ void DoomOPL::KeyOffEvent(unsigned char channel_num, unsigned char key)
     // Turn off voices being used to play this key.
     // If it is a double voice instrument there will be two.
 
-    for (i = 0; i < voice_alloced_num;)
-    {
-        if (voice_alloced_list[i]->channel == channel && voice_alloced_list[i]->key == key)
-        {
-            // Finished with this voice now.
-
-            ReleaseVoice(i);
-
-            continue;
-        }
-        i++;
-    }
+    ReleaseChannelVoices(channel, false, key);
 }
 
 // When all voices are in use, we must discard an existing voice to
@@ -468,8 +800,8 @@ void DoomOPL::KeyOffEvent(unsigned char channel_num, unsigned char key)
 
 void DoomOPL::ReplaceExistingVoice()
 {
-    unsigned int i;
-    unsigned int result;
+    opl_voice_t *voice;
+    opl_voice_t *result;
 
     // Check the allocated voices, if we find an instrument that is
     // of a lower priority to the new instrument, discard it.
@@ -479,14 +811,14 @@ void DoomOPL::ReplaceExistingVoice()
     // than higher-numbered channels, eg. MIDI channel 1 is never
     // discarded for MIDI channel 2.
 
-    result = 0;
+    result = voice_alloced_list.head;
 
-    for (i = 0; i < voice_alloced_num; i++)
+    for (voice = result; voice != NULL; voice = voice->next)
     {
-        if (voice_alloced_list[i]->current_instr_voice != 0
-         || voice_alloced_list[i]->channel >= voice_alloced_list[result]->channel)
+        if (voice->current_instr_voice != 0
+         || voice->channel >= result->channel)
         {
-            result = i;
+            result = voice;
         }
     }
 
@@ -498,40 +830,44 @@ void DoomOPL::ReplaceExistingVoice()
 
 void DoomOPL::ReplaceExistingVoiceDoom1(void)
 {
-    unsigned int i;
-    int result;
+    unsigned int ch;
 
-    result = 0;
+    // The first allocated voice of the highest numbered channel.
 
-    for (i = 0; i < voice_alloced_num; i++)
+    if (channel_voices_mask == 0)
     {
-        if (voice_alloced_list[i]->channel
-          > voice_alloced_list[result]->channel)
-        {
-            result = i;
-        }
+        ReleaseVoice(NULL);
+        return;
     }
 
-    ReleaseVoice(result);
+    ch = MIDI_CHANNELS_PER_TRACK - 1;
+
+    while ((channel_voices_mask & (1u << ch)) == 0)
+    {
+        --ch;
+    }
+
+    ReleaseVoice(channel_voices[ch].head);
 }
 
 void DoomOPL::ReplaceExistingVoiceDoom2(opl_channel_data_t *channel)
 {
     unsigned int i;
-    unsigned int result;
+    opl_voice_t *voice;
+    opl_voice_t *result;
     unsigned int priority;
 
-    result = 0;
+    result = voice_alloced_list.head;
 
     priority = 0x8000;
 
-    for (i = 0; i < voice_alloced_num - 3; i++)
+    for (i = 0, voice = result; voice != NULL && i < voice_alloced_num - 3; i++, voice = voice->next)
     {
-        if (voice_alloced_list[i]->priority < priority
-            && voice_alloced_list[i]->channel >= channel)
+        if (voice->priority < priority
+            && voice->channel >= channel)
         {
-            priority = voice_alloced_list[i]->priority;
-            result = i;
+            priority = voice->priority;
+            result = voice;
         }
     }
 
@@ -539,12 +875,13 @@ void DoomOPL::ReplaceExistingVoiceDoom2(opl_channel_data_t *channel)
 }
 
 
-unsigned int DoomOPL::FrequencyForVoice(opl_voice_t *voice)
+// Work out the frequency index of the note played by the voice,
+// the pitch bend of the channel is added to it later.
+
+static int NoteIndexForVoice(opl_voice_t *voice)
 {
-    genmidi_voice_t *gm_voice;
-    signed int freq_index;
-    unsigned int octave;
-    unsigned int sub_index;
+    const genmidi_voice_t *gm_voice;
+    signed int note_index;
     signed int note;
 
     note = voice->note;
@@ -571,48 +908,74 @@ unsigned int DoomOPL::FrequencyForVoice(opl_voice_t *voice)
         note -= 12;
     }
 
-    freq_index = 64 + 32 * note + voice->channel->bend;
+    note_index = 64 + 32 * note;
 
     // If this is the second voice of a double voice instrument, the
     // frequency index can be adjusted by the fine tuning field.
 
     if (voice->current_instr_voice != 0)
     {
-        freq_index += (voice->current_instr->fine_tuning / 2) - 64;
+        note_index += (voice->current_instr->fine_tuning / 2) - 64;
     }
 
-    if (freq_index < 0)
-    {
-        freq_index = 0;
-    }
+    return note_index;
+}
 
-    // The first 7 notes use the start of the table, while
-    // consecutive notes loop around the latter part.
+// Fill the table of register values for every possible frequency index.
 
-    if (freq_index < 284)
+void DoomOPL::InitFrequencyTable(void)
+{
+    signed int freq_index;
+    unsigned int octave;
+    unsigned int sub_index;
+    unsigned int i;
+
+    for (i = 0; i < OPL_FREQ_TABLE_LEN; ++i)
     {
-        return frequency_curve[freq_index];
-    }
+        freq_index = (signed int)i - OPL_FREQ_INDEX_BIAS;
 
-    sub_index = (freq_index - 284) % (12 * 32);
-    octave = (freq_index - 284) / (12 * 32);
+        if (freq_index < 0)
+        {
+            freq_index = 0;
+        }
 
-    // Once the seventh octave is reached, things break down.
-    // We can only go up to octave 7 as a maximum anyway (the OPL
-    // register only has three bits for octave number), but for the
-    // notes in octave 7, the first five bits have octave=7, the
-    // following notes have octave=6.  This 7/6 pattern repeats in
-    // following octaves (which are technically impossible to
-    // represent anyway).
+        // The first 7 notes use the start of the table, while
+        // consecutive notes loop around the latter part.
 
-    if (octave >= 7)
-    {
-        octave = 7;
+        if (freq_index < 284)
+        {
+            freq_table[i] = frequency_curve[freq_index];
+            continue;
+        }
+
+        sub_index = (freq_index - 284) % (12 * 32);
+        octave = (freq_index - 284) / (12 * 32);
+
+        // Once the seventh octave is reached, things break down.
+        // We can only go up to octave 7 as a maximum anyway (the OPL
+        // register only has three bits for octave number), but for the
+        // notes in octave 7, the first five bits have octave=7, the
+        // following notes have octave=6.  This 7/6 pattern repeats in
+        // following octaves (which are technically impossible to
+        // represent anyway).
+
+        if (octave >= 7)
+        {
+            octave = 7;
+        }
+
+        // Calculate the resulting register value to use for the frequency.
+
+        freq_table[i] = frequency_curve[sub_index + 284] | (octave << 10);
     }
+}
 
-    // Calculate the resulting register value to use for the frequency.
+// Get the A0 (low byte) and B0 (high byte, without the key-on bit)
+// register values of the voice's note with the channel's pitch bend.
 
-    return frequency_curve[sub_index + 284] | (octave << 10);
+unsigned int DoomOPL::FrequencyForVoice(opl_voice_t *voice)
+{
+    return freq_table[voice->note_index + voice->channel->bend + OPL_FREQ_INDEX_BIAS];
 }
 
 // Update the frequency that a voice is programmed to use.
@@ -640,14 +1003,14 @@ void DoomOPL::UpdateVoiceFrequency(opl_voice_t *voice)
 // key on event.
 
 void DoomOPL::VoiceKeyOn(opl_channel_data_t *channel,
-                       genmidi_instr_t *instrument,
+                       const genmidi_instr_t *instrument,
                        unsigned int instrument_voice,
                        unsigned int note,
                        unsigned int key,
                        unsigned int volume)
 {
     opl_voice_t *voice;
-    unsigned int i = 0;
+    unsigned int ch;
 
     // Find a voice to use for this new note.
 
@@ -656,16 +1019,17 @@ void DoomOPL::VoiceKeyOn(opl_channel_data_t *channel,
         return;
     }
 
-    voice = voice_free_list[0];
+    voice = voice_free_list.head;
 
+    VoiceListRemove(&voice_free_list, voice);
     voice_free_num--;
 
-    for (i = 0; i < voice_free_num; ++i)
-    {
-        voice_free_list[i] = voice_free_list[i + 1];
-    }
+    VoiceListPushBack(&voice_alloced_list, voice);
+    voice_alloced_num++;
 
-    voice_alloced_list[voice_alloced_num++] = voice;
+    ch = channel - channels;
+    ChannelListPushBack(&channel_voices[ch], voice);
+    channel_voices_mask |= 1u << ch;
 
     if (!opl_new && opl_drv_ver == opl_doom1_1_666)
     {
@@ -693,6 +1057,8 @@ void DoomOPL::VoiceKeyOn(opl_channel_data_t *channel,
 
     SetVoiceInstrument(voice, instrument, instrument_voice);
 
+    voice->note_index = NoteIndexForVoice(voice);
+
     // Set the volume level.
 
     SetVoiceVolume(voice, volume);
@@ -705,7 +1071,7 @@ void DoomOPL::VoiceKeyOn(opl_channel_data_t *channel,
 
 void DoomOPL::KeyOnEvent(unsigned char channel_num, unsigned char key, unsigned char volume)
 {
-    genmidi_instr_t *instrument;
+    const genmidi_instr_t *instrument;
     opl_channel_data_t *channel;
     unsigned int note, voicenum;
     bool doublev;
@@ -827,25 +1193,22 @@ void DoomOPL::ProgramChangeEvent(unsigned char channel_num, unsigned char instru
 
 void DoomOPL::SetChannelVolume(opl_channel_data_t *channel, unsigned int volume)
 {
-    unsigned int i;
+    opl_voice_t *voice;
 
     channel->volume = volume;
 
     // Update all voices that this channel is using.
 
-    for (i = 0; i < voice_alloced_num; ++i)
+    for (voice = channel_voices[channel - channels].head; voice != NULL; voice = voice->chan_next)
     {
-        if (voice_alloced_list[i]->channel == channel)
-        {
-            SetVoiceVolume(voice_alloced_list[i], voice_alloced_list[i]->note_volume);
-        }
+        SetVoiceVolume(voice, voice->note_volume);
     }
 }
 
 void DoomOPL::SetChannelPan(opl_channel_data_t *channel, unsigned int pan)
 {
     unsigned int reg_pan;
-    unsigned int i;
+    opl_voice_t *voice;
 
     if (opl_new)
     {
@@ -864,12 +1227,9 @@ void DoomOPL::SetChannelPan(opl_channel_data_t *channel, unsigned int pan)
         if (channel->pan != (int)reg_pan)
         {
             channel->pan = reg_pan;
-            for (i = 0; i < voice_alloced_num; i++)
+            for (voice = channel_voices[channel - channels].head; voice != NULL; voice = voice->chan_next)
             {
-                if (voice_alloced_list[i]->channel == channel)
-                {
-                    SetVoicePan(voice_alloced_list[i], reg_pan);
-                }
+                SetVoicePan(voice, reg_pan);
             }
         }
     }
@@ -878,19 +1238,7 @@ void DoomOPL::SetChannelPan(opl_channel_data_t *channel, unsigned int pan)
 // Handler for the MIDI_CONTROLLER_ALL_NOTES_OFF channel event.
 void DoomOPL::AllNotesOff(opl_channel_data_t *channel, unsigned int /*param*/)
 {
-    unsigned int i;
-
-    for (i = 0; i < voice_alloced_num;)
-    {
-        if (voice_alloced_list[i]->channel == channel)
-        {
-            // Finished with this voice now.
-
-            ReleaseVoice(i);
-            continue;
-        }
-        i++;
-    }
+    ReleaseChannelVoices(channel, true, 0);
 }
 
 void DoomOPL::ControllerEvent(unsigned char channel_num, unsigned char controller, unsigned char param)
@@ -930,11 +1278,7 @@ void DoomOPL::ControllerEvent(unsigned char channel_num, unsigned char controlle
 void DoomOPL::PitchBendEvent(unsigned char channel_num, unsigned char bend)
 {
     opl_channel_data_t *channel;
-    unsigned int i;
-    opl_voice_t *voice_updated_list[OPL_NUM_VOICES * 2];
-    unsigned int voice_updated_num = 0;
-    opl_voice_t *voice_not_updated_list[OPL_NUM_VOICES * 2];
-    unsigned int voice_not_updated_num = 0;
+    opl_voice_t *voice;
 
     // Update the channel bend value.  Only the MSB of the pitch bend
     // value is considered: this is what Doom does.
@@ -942,29 +1286,15 @@ void DoomOPL::PitchBendEvent(unsigned char channel_num, unsigned char bend)
     channel = TrackChannelForEvent(channel_num);
     channel->bend = bend - 64;
 
-    // Update all voices for this channel.
+    // Update all voices for this channel, and move them to the end of
+    // the alloced list keeping their order (This is how Doom behaves!)
 
-    for (i = 0; i < voice_alloced_num; ++i)
+    for (voice = channel_voices[channel - channels].head; voice != NULL; voice = voice->chan_next)
     {
-        if (voice_alloced_list[i]->channel == channel)
-        {
-            UpdateVoiceFrequency(voice_alloced_list[i]);
-            voice_updated_list[voice_updated_num++] = voice_alloced_list[i];
-        }
-        else
-        {
-            voice_not_updated_list[voice_not_updated_num++] = voice_alloced_list[i];
-        }
-    }
+        UpdateVoiceFrequency(voice);
 
-    for (i = 0; i < voice_not_updated_num; i++)
-    {
-        voice_alloced_list[i] = voice_not_updated_list[i];
-    }
-
-    for (i = 0; i < voice_updated_num; i++)
-    {
-        voice_alloced_list[i + voice_not_updated_num] = voice_updated_list[i];
+        VoiceListRemove(&voice_alloced_list, voice);
+        VoiceListPushBack(&voice_alloced_list, voice);
     }
 }
 
@@ -1051,12 +1381,80 @@ void DoomOPL::midi_program_change(unsigned char chan, unsigned char value)
     ProgramChangeEvent(chan, value);
 }
 
+void DoomOPL::midi_write_batch(const midisynth_event *events, unsigned int count, const unsigned int *sample_offsets)
+{
+    const midisynth_event *event;
+    unsigned char key, volume;
+    unsigned int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        event = &events[i];
+        key = event->data[0] > 0x7f ? 0x7f : event->data[0];
+        volume = event->data[1] > 0x7f ? 0x7f : event->data[1];
+        opl_write_offset = sample_offsets ? sample_offsets[i] : 0;
+
+        switch (event->type)
+        {
+            case MIDI_EVENT_NOTE_OFF:
+                KeyOffEvent(event->channel, key);
+                break;
+
+            case MIDI_EVENT_NOTE_ON:
+                KeyOnEvent(event->channel, key, volume);
+                break;
+
+            case MIDI_EVENT_CONTROLLER:
+                ControllerEvent(event->channel, key, volume);
+                break;
+
+            case MIDI_EVENT_PROGRAM_CHANGE:
+                ProgramChangeEvent(event->channel, event->data[0]);
+                break;
+
+            case MIDI_EVENT_PITCH_BEND:
+                PitchBendEvent(event->channel, event->data[1]);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    opl_write_offset = 0;
+}
+
+void DoomOPL::midi_raw_opl(unsigned char reg, unsigned char value)
+{
+    // The OPL2 songs don't set the output bits of the OPL3 mode
+    if(!raw_mode)
+    {
+        raw_mode = true;
+        if(opl_new)
+            opl_chips[0]->fm_writereg(OPL_REG_NEW_MODE, 0x00);
+    }
+
+#ifndef HW_DOS_BUILD
+    if(raw_writes_num == OPL_RAW_WRITES_MAX)
+        OPL_FlushRawWrites();
+
+    raw_writes[raw_writes_num][0] = reg;
+    raw_writes[raw_writes_num][1] = value;
+    ++raw_writes_num;
+#else
+    opl_chips[0]->fm_writereg(reg, value);
+#endif
+}
+
 void DoomOPL::midi_panic()
 {
     for(int i = 0; i < 16; i++)
     {
         AllNotesOff(TrackChannelForEvent(i), 0);
     }
+
+    if(raw_mode)
+        OPL_StopRawMode();
 }
 
 void DoomOPL::midi_reset()
@@ -1079,38 +1477,136 @@ void DoomOPL::InitChannel(opl_channel_data_t *channel)
 
 int DoomOPL::midi_init(int emu_type, unsigned int rate)
 {
-    opl = getchip();
+    unsigned int c;
+
+#ifndef HW_DOS_BUILD
+    if(m_workers)
+        m_workers->stop();
+
+    // The previous capture ends along with its chips
+    if(m_capture)
+    {
+        for(c = 0; c < opl_chips_num; ++c)
+        {
+            delete opl_chips[c];
+            opl_chips[c] = nullptr;
+        }
+
+        OPL_FinishCapture();
+    }
 
-    if(!opl || !opl->fm_init(emu_type, rate))
+    if(m_capturePath[0] && m_setup_chips > OPL_LOG_MAX_CHIPS)
+    {
+        s_fprintf(stderr, " - SYNTH ERROR: Register log can't keep more than %d chips\n", OPL_LOG_MAX_CHIPS);
+        flushout(stderr);
         return 0;
+    }
+#endif
+
+    // Drop chips left from the previous setup with more of them
+    for(c = m_setup_chips; c < opl_chips_num; ++c)
+    {
+        delete opl_chips[c];
+        opl_chips[c] = nullptr;
+    }
+
+    opl_chips_num = m_setup_chips;
+
+    for(c = 0; c < opl_chips_num; ++c)
+    {
+        if(!opl_chips[c])
+            opl_chips[c] = fm_chip::create();
+
+        if(!opl_chips[c] || !opl_chips[c]->fm_init(emu_type, rate))
+            return 0;
+    }
+
+#ifndef HW_DOS_BUILD
+    if(m_capturePath[0])
+    {
+        m_capture = new OPLLogWriter(rate, opl_chips_num);
+
+        for(c = 0; c < opl_chips_num; ++c)
+            opl_chips[c] = new OPLLogChip(opl_chips[c], m_capture, c);
+    }
+
+    if(opl_chips_num > 1)
+    {
+        if(!m_workers)
+            m_workers = new ChipWorkers;
+        m_workers->start(opl_chips, opl_chips_num);
+    }
+#endif
 
     return InitSynth();
 }
 
 const char *DoomOPL::getEmuName()
 {
-    return opl->getEmuName();
+    return opl_chips[0]->getEmuName();
 }
 
-void DoomOPL::ignore_env(bool ignore)
+void DoomOPL::set_options(const midisynth_options &options)
 {
-    m_ignore_env = ignore;
-}
+    const char *setup = options.setup;
 
-void DoomOPL::setup_string(const char *setup)
-{
-    m_setup_string = setup;
-}
+    m_bankPath[0] = '\0';
 
-bool DoomOPL::load_bank_file(const char *bank_path)
-{
-    strncpy(m_bankPath, bank_path, sizeof(m_bankPath));
-    return true;
+    if (options.bank_path)
+    {
+        strncpy(m_bankPath, options.bank_path, sizeof(m_bankPath) - 1);
+        m_bankPath[sizeof(m_bankPath) - 1] = '\0';
+    }
+
+    m_verbose = options.verbose;
+
+#ifndef HW_DOS_BUILD
+    m_setup_chips = options.chips;
+
+    if (m_setup_chips < 1)
+    {
+        m_setup_chips = 1;
+    }
+
+    if (m_setup_chips > OPL_MAX_CHIPS)
+    {
+        m_setup_chips = OPL_MAX_CHIPS;
+    }
+
+    m_capturePath[0] = '\0';
+
+    if (options.capture_path)
+    {
+        strncpy(m_capturePath, options.capture_path, sizeof(m_capturePath) - 1);
+        m_capturePath[sizeof(m_capturePath) - 1] = '\0';
+    }
+#endif
+
+    m_setup_opl3 = false;
+    m_setup_drv_ver = opl_doom_1_9;
+
+    if (setup)
+    {
+        if (strstr(setup, "-opl3"))
+        {
+            m_setup_opl3 = true;
+        }
+
+        if (strstr(setup, "-doom1"))
+        {
+            m_setup_drv_ver = opl_doom1_1_666;
+        }
+
+        // Overrides the previous one
+        if (strstr(setup, "-doom2"))
+        {
+            m_setup_drv_ver = opl_doom2_1_666;
+        }
+    }
 }
 
 int DoomOPL::InitSynth()
 {
-    const char *env;
     unsigned int i;
 
     memset(channels, 0, sizeof(channels));
@@ -1120,37 +1616,45 @@ int DoomOPL::InitSynth()
     voice_alloced_num = 0;
     voice_free_num = 0;
 
-    opl_new = 0;
-    opl_voices = OPL_NUM_VOICES;
-    opl_drv_ver = opl_doom_1_9;
-    s_fprintf(stdout, " - DEBUG: DOOM1 1.9 mode is default\n");
+    opl_new = m_setup_opl3;
+    opl_voices = (opl_new ? OPL_NUM_VOICES * 2 : OPL_NUM_VOICES) * opl_chips_num;
+    opl_drv_ver = m_setup_drv_ver;
 
-    env = m_setup_string ? m_setup_string : (m_ignore_env ? NULL : getenv("DMXOPTION"));
-    if (env)
+    raw_mode = false;
+#ifndef HW_DOS_BUILD
+    raw_writes_num = 0;
+#endif
+
+    if (m_verbose)
     {
-        if (strstr(env, "-opl3"))
+        static const char *const drv_names[] =
         {
-            opl_new = 1;
-            opl_voices = OPL_NUM_VOICES * 2;
-            s_fprintf(stdout, " - DEBUG: Enabling OPL3 mode\n");
-        }
+            "DOOM1 1.666", "DOOM2 1.666", "DOOM1 1.9"
+        };
+
+        s_fprintf(stdout, " - DEBUG: %s mode%s\n", drv_names[opl_drv_ver],
+                  opl_drv_ver == opl_doom_1_9 ? " (default)" : "");
 
-        if (strstr(env, "-doom1"))
+        if (opl_new)
         {
-            opl_drv_ver = opl_doom1_1_666;
-            s_fprintf(stdout, " - DEBUG: Setting DOOM1 1.666 mode (previous overriden)\n");
+            s_fprintf(stdout, " - DEBUG: Enabling OPL3 mode\n");
         }
 
-        if (strstr(env, "-doom2"))
+        if (opl_chips_num > 1)
         {
-            opl_drv_ver = opl_doom2_1_666;
-            s_fprintf(stdout, " - DEBUG: Setting DOOM2 1.666 mode (previous overriden)\n");
+            s_fprintf(stdout, " - DEBUG: Spreading %u voices over %u chips\n",
+                      opl_voices, opl_chips_num);
         }
+
+        flushout(stdout);
     }
 
-    flushout(stdout);
+    for (i = 0; i < opl_chips_num; i++)
+    {
+        OPL_InitRegisters(i << OPL_CHIP_SHIFT, opl_new);
+    }
 
-    OPL_InitRegisters(opl_new);
+    InitFrequencyTable();
 
     // Load instruments from GENMIDI lump:
 
@@ -1182,20 +1686,44 @@ int DoomOPL::SoftReset()
 
 DoomOPL::~DoomOPL()
 {
-    if(m_lump)
-        free(m_lump);
+    if(m_bank)
+        GENMIDI_ReleaseBank(m_bank);
+
+#ifndef HW_DOS_BUILD
+    delete m_workers;
+#endif
+
+    for(unsigned int c = 0; c < OPL_MAX_CHIPS; ++c)
+        delete opl_chips[c];
 
-    if(opl)
-        delete opl;
+#ifndef HW_DOS_BUILD
+    OPL_FinishCapture();
+#endif
 }
 
 #ifndef HW_DOS_BUILD
 void DoomOPL::midi_generate(int *buffer, unsigned int length) {
-    opl->fm_generate(buffer, length);
+    if(raw_writes_num > 0)
+        OPL_FlushRawWrites();
+
+    if(opl_chips_num > 1)
+        m_workers->generate(buffer, length);
+    else
+        opl_chips[0]->fm_generate(buffer, length);
+}
+
+void DoomOPL::midi_generate_float(float *buffer, unsigned int length) {
+    if(raw_writes_num > 0)
+        OPL_FlushRawWrites();
+
+    if(opl_chips_num > 1)
+        m_workers->generate_float(buffer, length);
+    else
+        opl_chips[0]->fm_generate_float(buffer, length);
 }
 #endif
 
-midisynth *getsynth()
+midisynth *midisynth::create()
 {
     DoomOPL *synth = new DoomOPL();
     return synth;
@@ -38,6 +38,19 @@
 
 #define OPL_NUM_OPERATORS   21
 #define OPL_NUM_VOICES      9
+#define OPL_MAX_CHIPS       8
+#define OPL_MAX_VOICES      (OPL_NUM_VOICES * 2 * OPL_MAX_CHIPS)
+
+// Bits of the register number above the chip's own ones select the chip
+#define OPL_CHIP_SHIFT      9
+
+// Raw register writes of OPL songs kept until the next generated block
+#define OPL_RAW_WRITES_MAX  256
+
+// Frequency index is made of the note (0..95), the pitch bend (-64..191)
+// and the fine tuning of the second voice (-64..63).
+#define OPL_FREQ_INDEX_BIAS 64
+#define OPL_FREQ_TABLE_LEN  (64 + 32 * 95 + 191 + 63 + OPL_FREQ_INDEX_BIAS + 1)
 
 #define OPL_REG_WAVEFORM_ENABLE   0x01
 #define OPL_REG_TIMER1            0x02
@@ -102,13 +115,44 @@ typedef struct
 } genmidi_instr_t;
 #pragma pack()
 
+// Shared GENMIDI bank, see genmidi_bank.h
+typedef struct genmidi_bank_s genmidi_bank_t;
+
+// Register writes to program one voice of the instrument, compiled once
+// at the bank load, the order of writes is the same as Doom does it.
+
+#define OPL_INSTR_PROGRAM_LEN 10
+
+typedef struct
+{
+    // Base of the register, the bit 0 selects the modulator operator
+    // instead of the carrier one.
+    byte reg;
+    byte value;
+} opl_reg_write_t;
+
+typedef struct
+{
+    opl_reg_write_t regs[OPL_INSTR_PROGRAM_LEN];
+
+    // Initial values of the level registers
+    byte car_volume;
+    byte mod_volume;
+
+    // Feedback register without the pan bits
+    byte feedback;
+
+    // Voice priority used by the Doom 2 1.666 voice replacement
+    byte priority;
+} opl_instr_program_t;
+
 // Data associated with a channel of a track that is currently playing.
 
 typedef struct
 {
     // The instrument currently used for this track.
 
-    genmidi_instr_t *instrument;
+    const genmidi_instr_t *instrument;
 
     // Volume level
 
@@ -134,11 +178,11 @@ struct opl_voice_s
     // The operators used by this voice:
     int op1, op2;
 
-    // Array of this voice
+    // Array of this voice, and the chip in the bits from OPL_CHIP_SHIFT
     int array;
 
     // Currently-loaded instrument data
-    genmidi_instr_t *current_instr;
+    const genmidi_instr_t *current_instr;
 
     // The voice number in the instrument to use.
     // This is normally set to zero; if this is a double voice
@@ -156,6 +200,9 @@ struct opl_voice_s
     // instrument, it is different.
     unsigned int note;
 
+    // Frequency index of the note without the pitch bend.
+    int note_index;
+
     // The frequency value being used.
     unsigned int freq;
 
@@ -171,163 +218,33 @@ struct opl_voice_s
 
     // Priority.
     unsigned int priority;
+
+    // Neighbours in the list of allocated voices, or in the free list.
+    opl_voice_t *prev, *next;
+
+    // Neighbours in the list of voices of the same channel.
+    opl_voice_t *chan_prev, *chan_next;
 };
 
+// Intrusive list of voices, the order of voices is the same as Doom
+// keeps in its arrays.
+
+typedef struct
+{
+    opl_voice_t *head;
+    opl_voice_t *tail;
+} opl_voice_list_t;
+
 typedef enum {
     opl_doom1_1_666,    // Doom 1 v1.666
     opl_doom2_1_666,    // Doom 2 v1.666, Hexen, Heretic
     opl_doom_1_9        // Doom v1.9, Strife
 } opl_driver_ver_t;
 
-// Operators used by the different voices.
-
-const int voice_operators[2][OPL_NUM_VOICES] = {
-    { 0x00, 0x01, 0x02, 0x08, 0x09, 0x0a, 0x10, 0x11, 0x12 },
-    { 0x03, 0x04, 0x05, 0x0b, 0x0c, 0x0d, 0x13, 0x14, 0x15 }
-};
-
-// Frequency values to use for each note.
-
-const unsigned short frequency_curve[] = {
-
-    0x133, 0x133, 0x134, 0x134, 0x135, 0x136, 0x136, 0x137,   // -1
-    0x137, 0x138, 0x138, 0x139, 0x139, 0x13a, 0x13b, 0x13b,
-    0x13c, 0x13c, 0x13d, 0x13d, 0x13e, 0x13f, 0x13f, 0x140,
-    0x140, 0x141, 0x142, 0x142, 0x143, 0x143, 0x144, 0x144,
-
-    0x145, 0x146, 0x146, 0x147, 0x147, 0x148, 0x149, 0x149,   // -2
-    0x14a, 0x14a, 0x14b, 0x14c, 0x14c, 0x14d, 0x14d, 0x14e,
-    0x14f, 0x14f, 0x150, 0x150, 0x151, 0x152, 0x152, 0x153,
-    0x153, 0x154, 0x155, 0x155, 0x156, 0x157, 0x157, 0x158,
-
-    // These are used for the first seven MIDI note values:
-
-    0x158, 0x159, 0x15a, 0x15a, 0x15b, 0x15b, 0x15c, 0x15d,   // 0
-    0x15d, 0x15e, 0x15f, 0x15f, 0x160, 0x161, 0x161, 0x162,
-    0x162, 0x163, 0x164, 0x164, 0x165, 0x166, 0x166, 0x167,
-    0x168, 0x168, 0x169, 0x16a, 0x16a, 0x16b, 0x16c, 0x16c,
-
-    0x16d, 0x16e, 0x16e, 0x16f, 0x170, 0x170, 0x171, 0x172,   // 1
-    0x172, 0x173, 0x174, 0x174, 0x175, 0x176, 0x176, 0x177,
-    0x178, 0x178, 0x179, 0x17a, 0x17a, 0x17b, 0x17c, 0x17c,
-    0x17d, 0x17e, 0x17e, 0x17f, 0x180, 0x181, 0x181, 0x182,
-
-    0x183, 0x183, 0x184, 0x185, 0x185, 0x186, 0x187, 0x188,   // 2
-    0x188, 0x189, 0x18a, 0x18a, 0x18b, 0x18c, 0x18d, 0x18d,
-    0x18e, 0x18f, 0x18f, 0x190, 0x191, 0x192, 0x192, 0x193,
-    0x194, 0x194, 0x195, 0x196, 0x197, 0x197, 0x198, 0x199,
-
-    0x19a, 0x19a, 0x19b, 0x19c, 0x19d, 0x19d, 0x19e, 0x19f,   // 3
-    0x1a0, 0x1a0, 0x1a1, 0x1a2, 0x1a3, 0x1a3, 0x1a4, 0x1a5,
-    0x1a6, 0x1a6, 0x1a7, 0x1a8, 0x1a9, 0x1a9, 0x1aa, 0x1ab,
-    0x1ac, 0x1ad, 0x1ad, 0x1ae, 0x1af, 0x1b0, 0x1b0, 0x1b1,
-
-    0x1b2, 0x1b3, 0x1b4, 0x1b4, 0x1b5, 0x1b6, 0x1b7, 0x1b8,   // 4
-    0x1b8, 0x1b9, 0x1ba, 0x1bb, 0x1bc, 0x1bc, 0x1bd, 0x1be,
-    0x1bf, 0x1c0, 0x1c0, 0x1c1, 0x1c2, 0x1c3, 0x1c4, 0x1c4,
-    0x1c5, 0x1c6, 0x1c7, 0x1c8, 0x1c9, 0x1c9, 0x1ca, 0x1cb,
-
-    0x1cc, 0x1cd, 0x1ce, 0x1ce, 0x1cf, 0x1d0, 0x1d1, 0x1d2,   // 5
-    0x1d3, 0x1d3, 0x1d4, 0x1d5, 0x1d6, 0x1d7, 0x1d8, 0x1d8,
-    0x1d9, 0x1da, 0x1db, 0x1dc, 0x1dd, 0x1de, 0x1de, 0x1df,
-    0x1e0, 0x1e1, 0x1e2, 0x1e3, 0x1e4, 0x1e5, 0x1e5, 0x1e6,
-
-    0x1e7, 0x1e8, 0x1e9, 0x1ea, 0x1eb, 0x1ec, 0x1ed, 0x1ed,   // 6
-    0x1ee, 0x1ef, 0x1f0, 0x1f1, 0x1f2, 0x1f3, 0x1f4, 0x1f5,
-    0x1f6, 0x1f6, 0x1f7, 0x1f8, 0x1f9, 0x1fa, 0x1fb, 0x1fc,
-    0x1fd, 0x1fe, 0x1ff, 0x200, 0x201, 0x201, 0x202, 0x203,
-
-    // First note of looped range used for all octaves:
-
-    0x204, 0x205, 0x206, 0x207, 0x208, 0x209, 0x20a, 0x20b,   // 7
-    0x20c, 0x20d, 0x20e, 0x20f, 0x210, 0x210, 0x211, 0x212,
-    0x213, 0x214, 0x215, 0x216, 0x217, 0x218, 0x219, 0x21a,
-    0x21b, 0x21c, 0x21d, 0x21e, 0x21f, 0x220, 0x221, 0x222,
-
-    0x223, 0x224, 0x225, 0x226, 0x227, 0x228, 0x229, 0x22a,   // 8
-    0x22b, 0x22c, 0x22d, 0x22e, 0x22f, 0x230, 0x231, 0x232,
-    0x233, 0x234, 0x235, 0x236, 0x237, 0x238, 0x239, 0x23a,
-    0x23b, 0x23c, 0x23d, 0x23e, 0x23f, 0x240, 0x241, 0x242,
-
-    0x244, 0x245, 0x246, 0x247, 0x248, 0x249, 0x24a, 0x24b,   // 9
-    0x24c, 0x24d, 0x24e, 0x24f, 0x250, 0x251, 0x252, 0x253,
-    0x254, 0x256, 0x257, 0x258, 0x259, 0x25a, 0x25b, 0x25c,
-    0x25d, 0x25e, 0x25f, 0x260, 0x262, 0x263, 0x264, 0x265,
-
-    0x266, 0x267, 0x268, 0x269, 0x26a, 0x26c, 0x26d, 0x26e,   // 10
-    0x26f, 0x270, 0x271, 0x272, 0x273, 0x275, 0x276, 0x277,
-    0x278, 0x279, 0x27a, 0x27b, 0x27d, 0x27e, 0x27f, 0x280,
-    0x281, 0x282, 0x284, 0x285, 0x286, 0x287, 0x288, 0x289,
-
-    0x28b, 0x28c, 0x28d, 0x28e, 0x28f, 0x290, 0x292, 0x293,   // 11
-    0x294, 0x295, 0x296, 0x298, 0x299, 0x29a, 0x29b, 0x29c,
-    0x29e, 0x29f, 0x2a0, 0x2a1, 0x2a2, 0x2a4, 0x2a5, 0x2a6,
-    0x2a7, 0x2a9, 0x2aa, 0x2ab, 0x2ac, 0x2ae, 0x2af, 0x2b0,
-
-    0x2b1, 0x2b2, 0x2b4, 0x2b5, 0x2b6, 0x2b7, 0x2b9, 0x2ba,   // 12
-    0x2bb, 0x2bd, 0x2be, 0x2bf, 0x2c0, 0x2c2, 0x2c3, 0x2c4,
-    0x2c5, 0x2c7, 0x2c8, 0x2c9, 0x2cb, 0x2cc, 0x2cd, 0x2ce,
-    0x2d0, 0x2d1, 0x2d2, 0x2d4, 0x2d5, 0x2d6, 0x2d8, 0x2d9,
-
-    0x2da, 0x2dc, 0x2dd, 0x2de, 0x2e0, 0x2e1, 0x2e2, 0x2e4,   // 13
-    0x2e5, 0x2e6, 0x2e8, 0x2e9, 0x2ea, 0x2ec, 0x2ed, 0x2ee,
-    0x2f0, 0x2f1, 0x2f2, 0x2f4, 0x2f5, 0x2f6, 0x2f8, 0x2f9,
-    0x2fb, 0x2fc, 0x2fd, 0x2ff, 0x300, 0x302, 0x303, 0x304,
-
-    0x306, 0x307, 0x309, 0x30a, 0x30b, 0x30d, 0x30e, 0x310,   // 14
-    0x311, 0x312, 0x314, 0x315, 0x317, 0x318, 0x31a, 0x31b,
-    0x31c, 0x31e, 0x31f, 0x321, 0x322, 0x324, 0x325, 0x327,
-    0x328, 0x329, 0x32b, 0x32c, 0x32e, 0x32f, 0x331, 0x332,
-
-    0x334, 0x335, 0x337, 0x338, 0x33a, 0x33b, 0x33d, 0x33e,   // 15
-    0x340, 0x341, 0x343, 0x344, 0x346, 0x347, 0x349, 0x34a,
-    0x34c, 0x34d, 0x34f, 0x350, 0x352, 0x353, 0x355, 0x357,
-    0x358, 0x35a, 0x35b, 0x35d, 0x35e, 0x360, 0x361, 0x363,
-
-    0x365, 0x366, 0x368, 0x369, 0x36b, 0x36c, 0x36e, 0x370,   // 16
-    0x371, 0x373, 0x374, 0x376, 0x378, 0x379, 0x37b, 0x37c,
-    0x37e, 0x380, 0x381, 0x383, 0x384, 0x386, 0x388, 0x389,
-    0x38b, 0x38d, 0x38e, 0x390, 0x392, 0x393, 0x395, 0x397,
-
-    0x398, 0x39a, 0x39c, 0x39d, 0x39f, 0x3a1, 0x3a2, 0x3a4,   // 17
-    0x3a6, 0x3a7, 0x3a9, 0x3ab, 0x3ac, 0x3ae, 0x3b0, 0x3b1,
-    0x3b3, 0x3b5, 0x3b7, 0x3b8, 0x3ba, 0x3bc, 0x3bd, 0x3bf,
-    0x3c1, 0x3c3, 0x3c4, 0x3c6, 0x3c8, 0x3ca, 0x3cb, 0x3cd,
-
-    // The last note has an incomplete range, and loops round back to
-    // the start.  Note that the last value is actually a buffer overrun
-    // and does not fit with the other values.
-
-    0x3cf, 0x3d1, 0x3d2, 0x3d4, 0x3d6, 0x3d8, 0x3da, 0x3db,   // 18
-    0x3dd, 0x3df, 0x3e1, 0x3e3, 0x3e4, 0x3e6, 0x3e8, 0x3ea,
-    0x3ec, 0x3ed, 0x3ef, 0x3f1, 0x3f3, 0x3f5, 0x3f6, 0x3f8,
-    0x3fa, 0x3fc, 0x3fe, 0x36c,
-};
-
-// Mapping from MIDI volume level to OPL level value.
-
-const unsigned int volume_mapping_table[] = {
-    0, 1, 3, 5, 6, 8, 10, 11,
-    13, 14, 16, 17, 19, 20, 22, 23,
-    25, 26, 27, 29, 30, 32, 33, 34,
-    36, 37, 39, 41, 43, 45, 47, 49,
-    50, 52, 54, 55, 57, 59, 60, 61,
-    63, 64, 66, 67, 68, 69, 71, 72,
-    73, 74, 75, 76, 77, 79, 80, 81,
-    82, 83, 84, 84, 85, 86, 87, 88,
-    89, 90, 91, 92, 92, 93, 94, 95,
-    96, 96, 97, 98, 99, 99, 100, 101,
-    101, 102, 103, 103, 104, 105, 105, 106,
-    107, 107, 108, 109, 109, 110, 110, 111,
-    112, 112, 113, 113, 114, 114, 115, 115,
-    116, 117, 117, 118, 118, 119, 119, 120,
-    120, 121, 121, 122, 122, 123, 123, 123,
-    124, 124, 125, 125, 126, 126, 127, 127
-};
-
-const unsigned int channel_map_table[MIDI_CHANNELS_PER_TRACK] = {
-    0, 1, 2, 3, 4, 5, 6, 7, 8, 15, 9, 10, 11, 12, 13, 14
-};
+#ifndef HW_DOS_BUILD
+class ChipWorkers;
+class OPLLogWriter;
+#endif
 
 #if defined(__DJGPP__)
 extern void DoomOPL_lockCodeBegin();
@@ -341,40 +258,79 @@ public:
     void dpmi_lock_begin() {}
 #endif
 private:
-    friend midisynth* getsynth();
+    friend midisynth *midisynth::create();
 
     DoomOPL();
 
-    fm_chip *opl = nullptr;
+    // Chips of the synth, more than one only in the multi-chip mode
+    fm_chip *opl_chips[OPL_MAX_CHIPS] = {};
+    unsigned int opl_chips_num = 1;
+#ifndef HW_DOS_BUILD
+    ChipWorkers *m_workers = nullptr;
+    // Recorder of register writes, when the capture is enabled
+    OPLLogWriter *m_capture = nullptr;
+    char m_capturePath[2048] = "";
+#endif
     opl_channel_data_t channels[MIDI_CHANNELS_PER_TRACK];
     opl_driver_ver_t opl_drv_ver = opl_doom_1_9;
-    const char *m_setup_string = nullptr;
-    bool m_ignore_env = false;
+
+    // Driver setup given by the options
+    bool m_setup_opl3 = false;
+    opl_driver_ver_t m_setup_drv_ver = opl_doom_1_9;
+    unsigned int m_setup_chips = 1;
+    bool m_verbose = false;
 
     // GENMIDI lump instrument data:
     char m_bankPath[2048] = "";
-    byte *m_lump = nullptr;
+    genmidi_bank_t *m_bank = nullptr;
+
+    const genmidi_instr_t *main_instrs;
+    const genmidi_instr_t *percussion_instrs;
 
-    genmidi_instr_t *main_instrs;
-    genmidi_instr_t *percussion_instrs;
+    // Values of A0/B0 registers pair for every frequency index
+    unsigned short freq_table[OPL_FREQ_TABLE_LEN];
+
+    // Compiled register programs of every voice of every instrument
+    opl_instr_program_t instr_programs[(GENMIDI_NUM_INSTRS + GENMIDI_NUM_PERCUSSION) * 2];
 
     // Voices:
 
-    opl_voice_t voices[OPL_NUM_VOICES * 2];
-    opl_voice_t *voice_free_list[OPL_NUM_VOICES * 2];
-    opl_voice_t *voice_alloced_list[OPL_NUM_VOICES * 2];
+    opl_voice_t voices[OPL_MAX_VOICES];
+    opl_voice_list_t voice_free_list;
+    opl_voice_list_t voice_alloced_list;
     unsigned int voice_free_num = 0;
     unsigned int voice_alloced_num = 0;
 
+    // Allocated voices of every channel, in the order of the allocated list
+    opl_voice_list_t channel_voices[MIDI_CHANNELS_PER_TRACK];
+    // Bit per channel which has allocated voices
+    unsigned int channel_voices_mask = 0;
+
     bool opl_new;
     unsigned int opl_voices;
 
+    // Count of frames into the next generated block to delay register writes by
+    unsigned int opl_write_offset = 0;
+
+    // Song made of raw register writes is playing
+    bool raw_mode = false;
+#ifndef HW_DOS_BUILD
+    byte raw_writes[OPL_RAW_WRITES_MAX][2];
+    unsigned int raw_writes_num = 0;
+#endif
+
     void OPL_WriteRegister(unsigned int reg, unsigned char data);
-    void OPL_InitRegisters(bool opl_new);
+    void OPL_InitRegisters(unsigned int chip, bool opl_new);
+    void OPL_FlushRawWrites(void);
+    void OPL_StopRawMode(void);
+#ifndef HW_DOS_BUILD
+    void OPL_FinishCapture(void);
+#endif
     bool LoadInstrumentTable(void);
-    void ReleaseVoice(unsigned int id);
-    void LoadOperatorData(int slot, genmidi_op_t *data, bool max_level, unsigned int *volume);
-    void SetVoiceInstrument(opl_voice_t *voice, genmidi_instr_t *instr, unsigned int instr_voice);
+    void ReleaseVoice(opl_voice_t *voice);
+    void ReleaseChannelVoices(opl_channel_data_t *channel, bool any_key, unsigned int key);
+    void CompileInstruments(void);
+    void SetVoiceInstrument(opl_voice_t *voice, const genmidi_instr_t *instr, unsigned int instr_voice);
     void SetVoiceVolume(opl_voice_t *voice, unsigned int volume);
     void SetVoicePan(opl_voice_t *voice, unsigned int pan);
     void InitVoices(void);
@@ -384,9 +340,10 @@ private:
     void ReplaceExistingVoice();
     void ReplaceExistingVoiceDoom1();
     void ReplaceExistingVoiceDoom2(opl_channel_data_t *channel);
+    void InitFrequencyTable(void);
     unsigned int FrequencyForVoice(opl_voice_t *voice);
     void UpdateVoiceFrequency(opl_voice_t *voice);
-    void VoiceKeyOn(opl_channel_data_t *channel, genmidi_instr_t *instrument, unsigned int instrument_voice,
+    void VoiceKeyOn(opl_channel_data_t *channel, const genmidi_instr_t *instrument, unsigned int instrument_voice,
                     unsigned int note, unsigned int key, unsigned int volume);
     void KeyOnEvent(unsigned char channel_num, unsigned char key, unsigned char volume);
     void ProgramChangeEvent(unsigned char channel_num, unsigned char instrument);
@@ -405,9 +362,7 @@ public:
 
     const char *getEmuName();
 
-    void ignore_env(bool ignore);
-    void setup_string(const char *setup);
-    bool load_bank_file(const char *bank_path);
+    void set_options(const midisynth_options &options);
 
     void midi_write(unsigned int data);
 
@@ -416,12 +371,15 @@ public:
     void midi_controller(unsigned char chan, unsigned char type, unsigned char value);
     void midi_pitch_bend(unsigned char chan, unsigned char msb, unsigned char lsb);
     void midi_program_change(unsigned char chan, unsigned char value);
+    void midi_raw_opl(unsigned char reg, unsigned char value);
+    void midi_write_batch(const midisynth_event *events, unsigned int count, const unsigned int *sample_offsets);
 
     void midi_panic();
     void midi_reset();
 
 #ifndef HW_DOS_BUILD
     void midi_generate(int *buffer, unsigned int length);
+    void midi_generate_float(float *buffer, unsigned int length);
 #endif
 
 #if defined(__DJGPP__)
@@ -0,0 +1,573 @@
+//
+// Copyright(C) 2025-2026 Vitaliy Novichkov
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#include <cstdio>
+#include <cstring>
+#include "opl_log.h"
+#include "../flushout.h"
+
+#define VGM_RATE            44100
+#define VGM_VERSION         0x151
+#define VGM_HEADER_SIZE     0x80
+
+#define VGM_CLOCK_YM3812    3579545
+#define VGM_CLOCK_YMF262    14318180
+// Bit of the clock value which tells there are two chips
+#define VGM_CLOCK_DUAL      0x40000000
+
+// Offsets of header fields
+#define VGM_OFF_EOF         0x04
+#define VGM_OFF_VERSION     0x08
+#define VGM_OFF_SAMPLES     0x18
+#define VGM_OFF_LOOP        0x1C
+#define VGM_OFF_LOOP_LEN    0x20
+#define VGM_OFF_DATA        0x34
+#define VGM_OFF_YM3812      0x50
+#define VGM_OFF_YM3526      0x54
+#define VGM_OFF_Y8950       0x58
+#define VGM_OFF_YMF262      0x5C
+
+static uint32_t readLE32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void writeLE32(uint8_t *p, uint32_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = (value >> 24) & 0xFF;
+}
+
+static void putWait(std::vector<uint8_t> &out, uint64_t samples)
+{
+    while(samples > 0)
+    {
+        if(samples <= 16)
+        {
+            out.push_back(static_cast<uint8_t>(0x70 + samples - 1));
+            return;
+        }
+
+        uint64_t chunk = samples > 0xFFFF ? 0xFFFF : samples;
+        out.push_back(0x61);
+        out.push_back(chunk & 0xFF);
+        out.push_back((chunk >> 8) & 0xFF);
+        samples -= chunk;
+    }
+}
+
+// Whole size of the command at the given position, zero if it's unknown
+static size_t commandSize(const uint8_t *d, size_t avail)
+{
+    uint8_t cmd = d[0];
+
+    if(cmd >= 0x70 && cmd <= 0x8F)
+        return 1;
+
+    switch(cmd)
+    {
+    case 0x62:
+    case 0x63:
+    case 0x66:
+        return 1;
+    case 0x67: // Data block
+        return avail < 7 ? 0 : 7 + static_cast<size_t>(readLE32(d + 3));
+    case 0x68:
+        return 12;
+    case 0x90:
+    case 0x91:
+    case 0x95:
+        return 5;
+    case 0x92:
+        return 6;
+    case 0x93:
+        return 11;
+    case 0x94:
+        return 2;
+    }
+
+    if(cmd >= 0x30 && cmd <= 0x3F)
+        return 2;
+    if(cmd >= 0x40 && cmd <= 0x4E)
+        return 3;
+    if(cmd == 0x4F || cmd == 0x50)
+        return 2;
+    if(cmd >= 0x51 && cmd <= 0x61)
+        return 3;
+    if(cmd >= 0xA0 && cmd <= 0xBF)
+        return 3;
+    if(cmd >= 0xC0 && cmd <= 0xDF)
+        return 4;
+    if(cmd >= 0xE0)
+        return 5;
+
+    return 0;
+}
+
+
+/****************************************************
+ *                    Log writer                    *
+ ****************************************************/
+
+OPLLogWriter::OPLLogWriter(unsigned int rate, unsigned int chips) :
+    m_rate(rate),
+    m_chips(chips)
+{}
+
+void OPLLogWriter::write(unsigned int chip, unsigned int offset, uint16_t reg, uint8_t value)
+{
+    Write w;
+    w.frame = m_frames + offset;
+    w.reg = reg;
+    w.chip = static_cast<uint8_t>(chip);
+    w.value = value;
+    m_writes.push_back(w);
+}
+
+void OPLLogWriter::advance(unsigned int frames)
+{
+    m_frames += frames;
+}
+
+bool OPLLogWriter::save(const char *path) const
+{
+    std::vector<uint8_t> out(VGM_HEADER_SIZE, 0);
+    uint64_t pos = 0, total;
+    bool opl3 = false;
+    uint32_t clock;
+
+    for(const Write &w : m_writes)
+    {
+        if(w.reg & 0x100)
+        {
+            opl3 = true;
+            break;
+        }
+    }
+
+    for(const Write &w : m_writes)
+    {
+        uint64_t sample = w.frame * VGM_RATE / m_rate;
+
+        // Writes delayed into the block may come before the later immediate ones
+        if(sample > pos)
+        {
+            putWait(out, sample - pos);
+            pos = sample;
+        }
+
+        if(opl3)
+            out.push_back((w.chip ? 0xAE : 0x5E) | ((w.reg >> 8) & 1));
+        else
+            out.push_back(w.chip ? 0xAA : 0x5A);
+
+        out.push_back(w.reg & 0xFF);
+        out.push_back(w.value);
+    }
+
+    total = m_frames * VGM_RATE / m_rate;
+    if(total > pos)
+        putWait(out, total - pos);
+    else
+        total = pos;
+
+    out.push_back(0x66);
+
+    std::memcpy(out.data(), "Vgm ", 4);
+    writeLE32(out.data() + VGM_OFF_EOF, static_cast<uint32_t>(out.size() - VGM_OFF_EOF));
+    writeLE32(out.data() + VGM_OFF_VERSION, VGM_VERSION);
+    writeLE32(out.data() + VGM_OFF_SAMPLES, static_cast<uint32_t>(total));
+    writeLE32(out.data() + VGM_OFF_DATA, VGM_HEADER_SIZE - VGM_OFF_DATA);
+
+    clock = opl3 ? VGM_CLOCK_YMF262 : VGM_CLOCK_YM3812;
+    if(m_chips > 1)
+        clock |= VGM_CLOCK_DUAL;
+    writeLE32(out.data() + (opl3 ? VGM_OFF_YMF262 : VGM_OFF_YM3812), clock);
+
+    FILE *f = std::fopen(path, "wb");
+    if(!f)
+    {
+        s_fprintf(stderr, " - ERROR: Can't open %s to write the register log\n", path);
+        flushout(stderr);
+        return false;
+    }
+
+    bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+    ok = (std::fclose(f) == 0) && ok;
+
+    if(!ok)
+    {
+        s_fprintf(stderr, " - ERROR: Failed to write the register log into %s\n", path);
+        flushout(stderr);
+    }
+
+    return ok;
+}
+
+
+/****************************************************
+ *                  Recording chip                  *
+ ****************************************************/
+
+OPLLogChip::OPLLogChip(fm_chip *chip, OPLLogWriter *log, unsigned int index) :
+    m_chip(chip),
+    m_log(log),
+    m_index(index)
+{}
+
+OPLLogChip::~OPLLogChip()
+{
+    delete m_chip;
+}
+
+const char *OPLLogChip::getEmuName()
+{
+    return m_chip->getEmuName();
+}
+
+int OPLLogChip::fm_init(int chip_emu, unsigned int rate)
+{
+    return m_chip->fm_init(chip_emu, rate);
+}
+
+void OPLLogChip::fm_writereg(unsigned short reg, unsigned char data)
+{
+    m_log->write(m_index, 0, reg, data);
+    m_chip->fm_writereg(reg, data);
+}
+
+void OPLLogChip::fm_writereg_at(unsigned int offset, unsigned short reg, unsigned char data)
+{
+    m_log->write(m_index, offset, reg, data);
+    m_chip->fm_writereg_at(offset, reg, data);
+}
+
+void OPLLogChip::fm_write_stats(unsigned long *writes, unsigned long *elided)
+{
+    m_chip->fm_write_stats(writes, elided);
+}
+
+void OPLLogChip::fm_generate(int *buffer, unsigned int length)
+{
+    m_chip->fm_generate(buffer, length);
+    if(m_index == 0)
+        m_log->advance(length);
+}
+
+void OPLLogChip::fm_generate_float(float *buffer, unsigned int length)
+{
+    m_chip->fm_generate_float(buffer, length);
+    if(m_index == 0)
+        m_log->advance(length);
+}
+
+
+/****************************************************
+ *                    Log player                    *
+ ****************************************************/
+
+OPLLogPlayer::~OPLLogPlayer()
+{
+    freeChips();
+}
+
+void OPLLogPlayer::freeChips()
+{
+    m_workers.stop();
+
+    for(unsigned int c = 0; c < OPL_LOG_MAX_CHIPS; ++c)
+    {
+        delete m_chips[c];
+        m_chips[c] = nullptr;
+    }
+}
+
+bool OPLLogPlayer::isLog(const char *path)
+{
+    char magic[4];
+    FILE *f = std::fopen(path, "rb");
+
+    if(!f)
+        return false;
+
+    bool ret = std::fread(magic, 1, 4, f) == 4 && std::memcmp(magic, "Vgm ", 4) == 0;
+    std::fclose(f);
+
+    return ret;
+}
+
+bool OPLLogPlayer::open(const char *path)
+{
+    FILE *f = std::fopen(path, "rb");
+    long size;
+
+    if(!f)
+    {
+        s_fprintf(stderr, " - ERROR: Can't open the register log %s\n", path);
+        flushout(stderr);
+        return false;
+    }
+
+    std::fseek(f, 0, SEEK_END);
+    size = std::ftell(f);
+    std::fseek(f, 0, SEEK_SET);
+
+    m_data.clear();
+    if(size > 0)
+    {
+        m_data.resize(static_cast<size_t>(size));
+        if(std::fread(m_data.data(), 1, m_data.size(), f) != m_data.size())
+            m_data.clear();
+    }
+
+    std::fclose(f);
+
+    if(m_data.size() < 0x40 || std::memcmp(m_data.data(), "Vgm ", 4) != 0)
+    {
+        s_fprintf(stderr, " - ERROR: %s is not a VGM file\n", path);
+        flushout(stderr);
+        return false;
+    }
+
+    const uint8_t *d = m_data.data();
+    uint32_t version = readLE32(d + VGM_OFF_VERSION);
+    uint32_t data_offset = readLE32(d + VGM_OFF_DATA);
+    uint32_t loop_offset = readLE32(d + VGM_OFF_LOOP);
+
+    m_data_begin = (version >= 0x150 && data_offset != 0) ? VGM_OFF_DATA + data_offset : 0x40;
+
+    if(m_data_begin > m_data.size())
+    {
+        s_fprintf(stderr, " - ERROR: VGM file %s is truncated\n", path);
+        flushout(stderr);
+        return false;
+    }
+
+    // The header ends where the data begins, the rest of fields are unset
+    uint32_t clocks = 0;
+    const size_t clock_offsets[4] = {VGM_OFF_YM3812, VGM_OFF_YM3526, VGM_OFF_Y8950, VGM_OFF_YMF262};
+    for(size_t i = 0; i < 4; ++i)
+    {
+        if(clock_offsets[i] + 4 <= m_data_begin)
+            clocks |= readLE32(d + clock_offsets[i]);
+    }
+
+    if(clocks == 0)
+    {
+        s_fprintf(stderr, " - ERROR: VGM file %s has no OPL chip data\n", path);
+        flushout(stderr);
+        return false;
+    }
+
+    m_chips_num = (clocks & VGM_CLOCK_DUAL) ? 2 : 1;
+    m_total_samples = readLE32(d + VGM_OFF_SAMPLES);
+    m_loop_samples = readLE32(d + VGM_OFF_LOOP_LEN);
+    m_loop_begin = loop_offset ? VGM_OFF_LOOP + loop_offset : 0;
+
+    if(m_loop_begin < m_data_begin || m_loop_begin >= m_data.size())
+    {
+        m_loop_begin = 0;
+        m_loop_samples = 0;
+    }
+
+    m_pos = m_data_begin;
+    m_samples = 0;
+    m_frames = 0;
+    m_end = false;
+
+    return true;
+}
+
+bool OPLLogPlayer::init(int emu_type, unsigned int rate)
+{
+    freeChips();
+
+    m_emu_type = emu_type;
+    m_rate = rate;
+
+    for(unsigned int c = 0; c < m_chips_num; ++c)
+    {
+        m_chips[c] = fm_chip::create();
+        if(!m_chips[c] || !m_chips[c]->fm_init(emu_type, rate))
+            return false;
+    }
+
+    m_workers.start(m_chips, m_chips_num);
+
+    return true;
+}
+
+const char *OPLLogPlayer::getEmuName()
+{
+    return m_chips[0] ? m_chips[0]->getEmuName() : "<none>";
+}
+
+void OPLLogPlayer::setLoop(bool enable)
+{
+    m_loop = enable;
+}
+
+void OPLLogPlayer::rewind()
+{
+    m_pos = m_data_begin;
+    m_samples = 0;
+    m_frames = 0;
+    m_end = false;
+
+    // The log starts from the chip reset state
+    if(m_chips[0])
+        init(m_emu_type, m_rate);
+}
+
+uint64_t OPLLogPlayer::samplesToFrames(uint64_t samples) const
+{
+    return (samples * m_rate + VGM_RATE - 1) / VGM_RATE;
+}
+
+void OPLLogPlayer::runCommands()
+{
+    const uint8_t *d = m_data.data();
+    const size_t size = m_data.size();
+
+    while(!m_end && samplesToFrames(m_samples) <= m_frames)
+    {
+        size_t len = m_pos < size ? commandSize(d + m_pos, size - m_pos) : 0;
+
+        if(len == 0 || len > size - m_pos || d[m_pos] == 0x66)
+        {
+            // Loops of zero length would never give any output
+            if(m_loop && m_loop_begin != 0 && m_loop_samples > 0)
+                m_pos = m_loop_begin;
+            else
+                m_end = true;
+            continue;
+        }
+
+        const uint8_t *cmd = d + m_pos;
+        m_pos += len;
+
+        switch(cmd[0])
+        {
+        case 0x5A: // YM3812
+        case 0x5B: // YM3526
+        case 0x5C: // Y8950
+        case 0x5E: // YMF262 port 0
+            m_chips[0]->fm_writereg(cmd[1], cmd[2]);
+            break;
+        case 0x5F: // YMF262 port 1
+            m_chips[0]->fm_writereg(0x100 | cmd[1], cmd[2]);
+            break;
+        case 0xAA: // Second chips of the same
+        case 0xAB:
+        case 0xAC:
+        case 0xAE:
+            if(m_chips_num > 1)
+                m_chips[1]->fm_writereg(cmd[1], cmd[2]);
+            break;
+        case 0xAF:
+            if(m_chips_num > 1)
+                m_chips[1]->fm_writereg(0x100 | cmd[1], cmd[2]);
+            break;
+        case 0x61:
+            m_samples += cmd[1] | (cmd[2] << 8);
+            break;
+        case 0x62:
+            m_samples += 735;
+            break;
+        case 0x63:
+            m_samples += 882;
+            break;
+        default:
+            if(cmd[0] >= 0x70 && cmd[0] <= 0x7F)
+                m_samples += (cmd[0] & 0x0F) + 1;
+            else if(cmd[0] >= 0x80 && cmd[0] <= 0x8F)
+                m_samples += cmd[0] & 0x0F;
+            break; // Commands of other chips
+        }
+    }
+}
+
+void OPLLogPlayer::renderBlock(int *buffer, unsigned int frames)
+{
+    m_workers.generate(buffer, frames);
+}
+
+void OPLLogPlayer::renderBlock(float *buffer, unsigned int frames)
+{
+    m_workers.generate_float(buffer, frames);
+}
+
+template<class T>
+unsigned int OPLLogPlayer::render(T *buffer, unsigned int frames)
+{
+    unsigned int done = 0;
+
+    if(!m_chips[0])
+        return 0;
+
+    while(done < frames)
+    {
+        runCommands();
+
+        // Commands are run up to the next wait, unless the log has ended
+        uint64_t next = samplesToFrames(m_samples);
+        if(next <= m_frames)
+            break;
+
+        uint64_t count = next - m_frames;
+        if(count > frames - done)
+            count = frames - done;
+
+        renderBlock(buffer + done * 2, static_cast<unsigned int>(count));
+        done += static_cast<unsigned int>(count);
+        m_frames += count;
+    }
+
+    return done;
+}
+
+unsigned int OPLLogPlayer::generate(int *buffer, unsigned int frames)
+{
+    return render(buffer, frames);
+}
+
+unsigned int OPLLogPlayer::generate_float(float *buffer, unsigned int frames)
+{
+    return render(buffer, frames);
+}
+
+double OPLLogPlayer::tell() const
+{
+    return m_rate ? static_cast<double>(m_frames) / m_rate : 0.0;
+}
+
+double OPLLogPlayer::duration() const
+{
+    return static_cast<double>(m_total_samples) / VGM_RATE;
+}
+
+double OPLLogPlayer::loopStart() const
+{
+    if(m_loop_begin == 0 || m_loop_samples == 0 || m_loop_samples > m_total_samples)
+        return -1.0;
+
+    return static_cast<double>(m_total_samples - m_loop_samples) / VGM_RATE;
+}
+
+bool OPLLogPlayer::atEnd() const
+{
+    return m_end && samplesToFrames(m_samples) <= m_frames;
+}
@@ -0,0 +1,193 @@
+//
+// Copyright(C) 2025-2026 Vitaliy Novichkov
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef OPL_LOG_H
+#define OPL_LOG_H
+
+#include <stdint.h>
+#include <vector>
+#include "../interface.h"
+#include "chip_workers.h"
+
+// The VGM format knows at most two chips of the same type
+#define OPL_LOG_MAX_CHIPS 2
+
+/**
+ * @brief Recorder of register writes into the VGM file
+ *
+ * Writes are kept in memory with the time of the output frame they were made
+ * at, and converted into the VGM's 44100 Hz timeline on save. The log gets
+ * marked as YMF262 once any write touches the second register array,
+ * otherwise as YM3812.
+ */
+class OPLLogWriter
+{
+    struct Write
+    {
+        uint64_t frame;
+        uint16_t reg;
+        uint8_t chip;
+        uint8_t value;
+    };
+
+    std::vector<Write> m_writes;
+    unsigned int m_rate = 0;
+    unsigned int m_chips = 1;
+    // Count of frames rendered so far
+    uint64_t m_frames = 0;
+
+public:
+    OPLLogWriter(unsigned int rate, unsigned int chips);
+
+    /**
+     * @brief Record the register write
+     * @param chip Index of the chip
+     * @param offset Count of frames since the current position
+     * @param reg Register address
+     * @param value Value written
+     */
+    void write(unsigned int chip, unsigned int offset, uint16_t reg, uint8_t value);
+
+    /**
+     * @brief Move the current position forward
+     * @param frames Count of frames rendered
+     */
+    void advance(unsigned int frames);
+
+    /**
+     * @brief Write the log into the file
+     * @param path Path to the VGM file
+     * @return true on success
+     */
+    bool save(const char *path) const;
+};
+
+/**
+ * @brief Chip which passes everything to the real one and records the writes
+ *
+ * Only the first chip moves the log's position forward, so every chip of the
+ * synth shares the same timeline.
+ */
+class OPLLogChip : public fm_chip
+{
+    fm_chip *m_chip;
+    OPLLogWriter *m_log;
+    unsigned int m_index;
+
+public:
+    /**
+     * @param chip Real chip, owned by this one from now
+     * @param log Recorder of writes
+     * @param index Index of the chip in the synth
+     */
+    OPLLogChip(fm_chip *chip, OPLLogWriter *log, unsigned int index);
+    ~OPLLogChip();
+
+    const char *getEmuName();
+    int fm_init(int chip_emu, unsigned int rate);
+    void fm_writereg(unsigned short reg, unsigned char data);
+    void fm_writereg_at(unsigned int offset, unsigned short reg, unsigned char data);
+    void fm_write_stats(unsigned long *writes, unsigned long *elided);
+    void fm_generate(int *buffer, unsigned int length);
+    void fm_generate_float(float *buffer, unsigned int length);
+};
+
+/**
+ * @brief Player of VGM files made for OPL chips
+ *
+ * Plays YM3526, YM3812, Y8950 and YMF262 register writes (one or two chips)
+ * straight into the chip emulator, with no sequencer and no synth involved.
+ * Commands of other chips are skipped. Compressed (.vgz) files are not
+ * supported.
+ */
+class OPLLogPlayer
+{
+    std::vector<uint8_t> m_data;
+    size_t m_data_begin = 0;
+    size_t m_loop_begin = 0;
+    size_t m_pos = 0;
+    uint64_t m_total_samples = 0;
+    uint64_t m_loop_samples = 0;
+    unsigned int m_chips_num = 1;
+
+    fm_chip *m_chips[OPL_LOG_MAX_CHIPS] = {};
+    ChipWorkers m_workers;
+
+    int m_emu_type = 0;
+    unsigned int m_rate = 0;
+    bool m_loop = false;
+    bool m_end = false;
+    // Position of commands in 44100 Hz samples, and of the output in frames
+    uint64_t m_samples = 0;
+    uint64_t m_frames = 0;
+
+    uint64_t samplesToFrames(uint64_t samples) const;
+    void freeChips();
+    void runCommands();
+    void renderBlock(int *buffer, unsigned int frames);
+    void renderBlock(float *buffer, unsigned int frames);
+
+    template<class T>
+    unsigned int render(T *buffer, unsigned int frames);
+
+public:
+    OPLLogPlayer() = default;
+    ~OPLLogPlayer();
+
+    OPLLogPlayer(const OPLLogPlayer &) = delete;
+    OPLLogPlayer &operator=(const OPLLogPlayer &) = delete;
+
+    /**
+     * @brief Check the file has the VGM signature
+     * @param path Path to the file
+     * @return true if the file is the VGM log
+     */
+    static bool isLog(const char *path);
+
+    /**
+     * @brief Load the log
+     * @param path Path to the VGM file
+     * @return true on success, the reason of failure is printed to stderr
+     */
+    bool open(const char *path);
+
+    /**
+     * @brief Create chips for the loaded log
+     * @param emu_type Chip emulator to play with
+     * @param rate Output sample rate
+     * @return true on success
+     */
+    bool init(int emu_type, unsigned int rate);
+
+    const char *getEmuName();
+
+    void setLoop(bool enable);
+    void rewind();
+
+    /**
+     * @brief Play the log into the output
+     * @param buffer Output stereo frames
+     * @param frames Count of frames
+     * @return Count of frames made, less than requested at the end of the log
+     */
+    unsigned int generate(int *buffer, unsigned int frames);
+    unsigned int generate_float(float *buffer, unsigned int frames);
+
+    double tell() const;
+    double duration() const;
+    double loopStart() const;
+    bool atEnd() const;
+};
+
+#endif // OPL_LOG_H